@@ -1,15 +1,16 @@
+import hashlib
 import logging
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome import automation
 from esphome.components import uart, binary_sensor, text_sensor, sensor, button
-from esphome.components.uart import button as uart_button
 
 from esphome.const import (
     CONF_DATA,
     CONF_DURATION,
     CONF_ID,
     CONF_TRIGGER_ID,
+    CONF_TYPE,
     CONF_UART_ID,
     DEVICE_CLASS_CONNECTIVITY,
     DEVICE_CLASS_DISTANCE,
@@ -18,9 +19,13 @@ from esphome.const import (
     ENTITY_CATEGORY_DIAGNOSTIC,
     ICON_ARROW_EXPAND_VERTICAL,
     ICON_COUNTER,
+    ICON_SPEEDOMETER,
     ICON_TIMER,
     STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
     UNIT_CENTIMETER,
+    UNIT_HOUR,
+    UNIT_PERCENT,
     UNIT_SECOND,
 )
 
@@ -29,6 +34,7 @@ _LOGGER = logging.getLogger(__name__)
 CODEOWNERS = ["@muxa"]
 DEPENDENCIES = ["uart", "button"]
 AUTO_LOAD = ["binary_sensor", "text_sensor", "sensor"]
+MULTI_CONF = True
 
 loctekmotion_desk_ns = cg.esphome_ns.namespace("loctekmotion_desk")
 
@@ -36,12 +42,43 @@ LoctekMotionOnTimerDoneTrigger = loctekmotion_desk_ns.class_(
     "LoctekMotionOnTimerDoneTrigger", automation.Trigger.template()
 )
 
-LoctekMotionSetTimerAction = loctekmotion_desk_ns.class_("LoctekMotionSetTimerAction", automation.Action)
+LoctekMotionOnMoveToHeightDoneTrigger = loctekmotion_desk_ns.class_(
+    "LoctekMotionOnMoveToHeightDoneTrigger", automation.Trigger.template(cg.float_)
+)
+
+FramePayload = loctekmotion_desk_ns.struct("FramePayload")
+LoctekMotionOnFrameTrigger = loctekmotion_desk_ns.class_(
+    "LoctekMotionOnFrameTrigger", automation.Trigger.template(FramePayload)
+)
 
 LoctekMotionComponent = loctekmotion_desk_ns.class_(
     "LoctekMotionComponent", cg.PollingComponent
 )
 
+LoctekMotionButton = loctekmotion_desk_ns.class_(
+    "LoctekMotionButton", button.Button, cg.Parented.template(LoctekMotionComponent)
+)
+
+LoctekMotionSetTimerAction = loctekmotion_desk_ns.class_("LoctekMotionSetTimerAction", automation.Action)
+LoctekMotionMoveToHeightAction = loctekmotion_desk_ns.class_("LoctekMotionMoveToHeightAction", automation.Action)
+LoctekMotionPressKeyAction = loctekmotion_desk_ns.class_("LoctekMotionPressKeyAction", automation.Action)
+LoctekMotionStopAction = loctekmotion_desk_ns.class_("LoctekMotionStopAction", automation.Action)
+LoctekMotionDumpFlightRecorderAction = loctekmotion_desk_ns.class_(
+    "LoctekMotionDumpFlightRecorderAction", automation.Action
+)
+LoctekMotionDumpTransitionTraceAction = loctekmotion_desk_ns.class_(
+    "LoctekMotionDumpTransitionTraceAction", automation.Action
+)
+
+TX_PRIORITY_WAKE = loctekmotion_desk_ns.TX_PRIORITY_WAKE
+TX_PRIORITY_TIMER = loctekmotion_desk_ns.TX_PRIORITY_TIMER
+TX_PRIORITY_MOTION = loctekmotion_desk_ns.TX_PRIORITY_MOTION
+
+# see frame_dispatch.h and the LoctekMotionComponent constructor
+FRAME_HANDLER_SLOTS = 8
+FRAME_TYPE_DISPLAY = 0x12
+FRAME_TYPES_WITH_DEFAULTS = [0x11, 0x14, 0x15]  # replaced by an on_frame handler
+
 MicronPressAction = loctekmotion_desk_ns.class_("MicronPressAction", automation.Action)
 
 CONF_CONNECTED = "connected"
@@ -50,8 +87,15 @@ CONF_TIMER_ACTIVE = "timer_active"
 CONF_HEIGHT = "height"
 CONF_TIMER = "timer"
 CONF_CONTROL_STATUS = "control_status"
+CONF_PUBLISH_INTERVAL = "publish_interval"
+CONF_VELOCITY = "velocity"
+CONF_DIRECTION = "direction"
+CONF_PRESET_HEIGHTS = ["preset1_height", "preset2_height", "preset3_height"]
+CONF_ETA = "eta"
 
 CONF_ON_TIMER_DONE_ACTION = "on_timer_done"
+CONF_ON_MOVE_TO_HEIGHT_DONE_ACTION = "on_move_to_height_done"
+CONF_ON_FRAME = "on_frame"
 
 CONF_UP_BUTTON = "up_button"
 CONF_DOWN_BUTTON = "down_button"
@@ -60,9 +104,207 @@ CONF_PRESET2_BUTTON = "preset2_button"
 CONF_PRESET3_BUTTON = "preset3_button"
 CONF_MEMORY_BUTTON = "memory_button"
 CONF_TIMER_BUTTON = "timer_button"
+CONF_KEY = "key"
 CONF_TIMER_SET_ACTION = "timer_set"
+CONF_TIMER_FAST_SET = "timer_fast_set"
+CONF_COUNT_ALLOCATIONS = "count_allocations"
+CONF_FLIGHT_RECORDER_SIZE = "flight_recorder_size"
+CONF_TRANSITION_TRACE_SIZE = "transition_trace_size"
+
+CONF_DIAGNOSTICS_INTERVAL = "diagnostics_interval"
+CONF_FRAME_RATE = "frame_rate"
+CONF_CRC_ERRORS = "crc_errors"
+CONF_FRAMING_ERRORS = "framing_errors"
+CONF_DROPPED_BYTES = "dropped_bytes"
+CONF_UNKNOWN_FRAMES = "unknown_frames"
+CONF_UNHANDLED_FRAMES = "unhandled_frames"
+CONF_REPEAT_FRAMES = "repeat_frames"
+CONF_TRANSITION_RATE = "transition_rate"
+CONF_LOOP_TIME_MAX = "loop_time_max"
+CONF_LOOP_TIME_AVG = "loop_time_avg"
+
+CONF_STANDING_HEIGHT = "standing_height"
+CONF_USAGE_PUBLISH_INTERVAL = "usage_publish_interval"
+CONF_USAGE_SAVE_INTERVAL = "usage_save_interval"
+CONF_SITTING_TIME = "sitting_time"
+CONF_STANDING_TIME = "standing_time"
+CONF_POSTURE_CHANGES = "posture_changes"
+CONF_MOTOR_UP_TIME = "motor_up_time"
+CONF_MOTOR_DOWN_TIME = "motor_down_time"
+CONF_TIMER_COMPLETIONS = "timer_completions"
 
 ICON_STATE_MACHINE = "mdi:state-machine"
+ICON_SWAP_VERTICAL = "mdi:swap-vertical"
+ICON_TIMER_SAND = "mdi:timer-sand"
+
+ICON_TIMER_OUTLINE = "mdi:timer-outline"
+ICON_SWAP_HORIZONTAL = "mdi:swap-horizontal"
+ICON_ALERT_CIRCLE_OUTLINE = "mdi:alert-circle-outline"
+ICON_CHAIR_ROLLING = "mdi:chair-rolling"
+ICON_HUMAN_HANDSUP = "mdi:human-handsup"
+ICON_ENGINE = "mdi:engine"
+
+UNIT_CENTIMETER_PER_SECOND = "cm/s"
+UNIT_FRAMES_PER_SECOND = "frames/s"
+UNIT_PER_MINUTE = "1/min"
+UNIT_MICROSECOND = "µs"
+
+
+def diagnostic_rate_schema(unit, accuracy_decimals):
+    return sensor.sensor_schema(
+        unit_of_measurement=unit,
+        accuracy_decimals=accuracy_decimals,
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        icon=ICON_TIMER_OUTLINE if unit == UNIT_MICROSECOND else ICON_SWAP_HORIZONTAL,
+    )
+
+
+def diagnostic_count_schema():
+    return sensor.sensor_schema(
+        accuracy_decimals=0,
+        state_class=STATE_CLASS_TOTAL_INCREASING,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        icon=ICON_ALERT_CIRCLE_OUTLINE,
+    )
+
+
+DIAGNOSTIC_SENSORS = {
+    CONF_FRAME_RATE: diagnostic_rate_schema(UNIT_FRAMES_PER_SECOND, 1),
+    CONF_CRC_ERRORS: diagnostic_count_schema(),
+    CONF_FRAMING_ERRORS: diagnostic_count_schema(),
+    CONF_DROPPED_BYTES: diagnostic_count_schema(),
+    CONF_UNKNOWN_FRAMES: diagnostic_count_schema(),
+    CONF_UNHANDLED_FRAMES: diagnostic_count_schema(),
+    CONF_REPEAT_FRAMES: diagnostic_rate_schema(UNIT_PERCENT, 0),
+    CONF_TRANSITION_RATE: diagnostic_rate_schema(UNIT_PER_MINUTE, 1),
+    CONF_LOOP_TIME_MAX: diagnostic_rate_schema(UNIT_MICROSECOND, 0),
+    CONF_LOOP_TIME_AVG: diagnostic_rate_schema(UNIT_MICROSECOND, 0),
+}
+
+def usage_time_schema(unit, accuracy_decimals, icon):
+    return sensor.sensor_schema(
+        unit_of_measurement=unit,
+        accuracy_decimals=accuracy_decimals,
+        device_class=DEVICE_CLASS_DURATION,
+        state_class=STATE_CLASS_TOTAL_INCREASING,
+        icon=icon,
+    )
+
+
+def usage_count_schema():
+    return sensor.sensor_schema(
+        accuracy_decimals=0,
+        state_class=STATE_CLASS_TOTAL_INCREASING,
+        icon=ICON_COUNTER,
+    )
+
+
+USAGE_SENSORS = {
+    CONF_SITTING_TIME: usage_time_schema(UNIT_HOUR, 2, ICON_CHAIR_ROLLING),
+    CONF_STANDING_TIME: usage_time_schema(UNIT_HOUR, 2, ICON_HUMAN_HANDSUP),
+    CONF_POSTURE_CHANGES: usage_count_schema(),
+    CONF_MOTOR_UP_TIME: usage_time_schema(UNIT_SECOND, 0, ICON_ENGINE),
+    CONF_MOTOR_DOWN_TIME: usage_time_schema(UNIT_SECOND, 0, ICON_ENGINE),
+    CONF_TIMER_COMPLETIONS: usage_count_schema(),
+}
+
+# key bits in the key frame
+DESK_KEYS = {
+    "up": 0x01,
+    "down": 0x02,
+    "preset1": 0x04,
+    "preset2": 0x08,
+    "preset3": 0x10,
+    "memory": 0x20,
+    "timer": 0x40,
+}
+
+
+def validate_keys(value):
+    """Key name, or a list of keys pressed together, to the key bits."""
+    keys = 0
+    for key in cv.ensure_list(cv.one_of(*DESK_KEYS, lower=True))(value):
+        keys |= DESK_KEYS[key]
+    return keys
+
+
+def key_frame_crc(keys):
+    crc = 0xFFFF
+    for byte in (0x06, 0x02, keys, 0x00):
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def validate_key_frame_data(value):
+    """Raw key frame, as configured before `key`, to the key bits."""
+    data = list(uart.validate_raw_data(value))
+    if (
+        len(data) != 8
+        or data[:3] != [0x9B, 0x06, 0x02]
+        or data[3] & ~0x7F
+        or data[4] != 0x00
+        or data[7] != 0x9D
+        or (data[5] << 8 | data[6]) != key_frame_crc(data[3])
+    ):
+        raise cv.Invalid("Not a key frame, use 'key' instead (e.g. 'key: [memory, up]')")
+    _LOGGER.warning("'data' of the desk buttons is deprecated, use 'key' instead (or leave it out for the default)")
+    return data[3]
+
+
+def validate_frame_types(value):
+    """on_frame handlers must fit the component's frame handler slots (FRAME_HANDLER_SLOTS)"""
+    types = [action[CONF_TYPE] for action in value]
+    for frame_type in types:
+        if frame_type == FRAME_TYPE_DISPLAY:
+            raise cv.Invalid(f"Frame type 0x{frame_type:02X} is the display, which the component decodes itself")
+    duplicates = sorted({frame_type for frame_type in types if types.count(frame_type) > 1})
+    if duplicates:
+        raise cv.Invalid(f"Frame type 0x{duplicates[0]:02X} has more than one on_frame handler")
+    new_types = set(types) - set(FRAME_TYPES_WITH_DEFAULTS)
+    if len(new_types) > FRAME_HANDLER_SLOTS - 1 - len(FRAME_TYPES_WITH_DEFAULTS):
+        raise cv.Invalid(
+            f"At most {FRAME_HANDLER_SLOTS - 1 - len(FRAME_TYPES_WITH_DEFAULTS)} frame types besides "
+            f"0x11, 0x14 and 0x15 can have an on_frame handler"
+        )
+    return value
+
+
+DESK_BUTTON_SCHEMA = cv.All(
+    button.button_schema(LoctekMotionButton).extend(
+        {
+            cv.Optional(CONF_KEY): validate_keys,
+            cv.Optional(CONF_DATA): validate_key_frame_data,
+        }
+    ),
+    cv.has_at_most_one_key(CONF_KEY, CONF_DATA),
+)
+
+# default keys and send priority of each button
+DESK_BUTTONS = {
+    CONF_UP_BUTTON: ("up", TX_PRIORITY_MOTION),
+    CONF_DOWN_BUTTON: ("down", TX_PRIORITY_MOTION),
+    CONF_PRESET1_BUTTON: ("preset1", TX_PRIORITY_MOTION),
+    CONF_PRESET2_BUTTON: ("preset2", TX_PRIORITY_MOTION),
+    CONF_PRESET3_BUTTON: ("preset3", TX_PRIORITY_MOTION),
+    CONF_MEMORY_BUTTON: ("memory", TX_PRIORITY_WAKE),
+    CONF_TIMER_BUTTON: ("timer", TX_PRIORITY_TIMER),
+}
+
+
+def key_priority(keys):
+    """Send priority of pressing the key bits, the one of the button for these keys.
+
+    Of keys pressed together, a motion goes before the timer and the timer
+    before memory, e.g. [memory, up] is sent like up.
+    """
+    for priority in (TX_PRIORITY_MOTION, TX_PRIORITY_TIMER, TX_PRIORITY_WAKE):
+        if any(keys & DESK_KEYS[key] for key, button_priority in DESK_BUTTONS.values() if button_priority is priority):
+            return priority
+    return TX_PRIORITY_MOTION
+
 
 CONFIG_SCHEMA = cv.All(
     cv.Schema(
@@ -81,6 +323,10 @@ CONFIG_SCHEMA = cv.All(
                 device_class=DEVICE_CLASS_DISTANCE,
                 state_class=STATE_CLASS_MEASUREMENT,
                 icon=ICON_ARROW_EXPAND_VERTICAL,
+            ).extend(
+                {
+                    cv.Optional(CONF_PUBLISH_INTERVAL, default="0ms"): cv.positive_time_period_milliseconds,
+                }
             ),
             cv.Optional(CONF_TIMER): sensor.sensor_schema(
                 unit_of_measurement=UNIT_SECOND,
@@ -96,18 +342,64 @@ CONFIG_SCHEMA = cv.All(
                 entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
                 icon=ICON_STATE_MACHINE
             ),
-            cv.Optional(CONF_UP_BUTTON): uart_button.CONFIG_SCHEMA,
-            cv.Optional(CONF_DOWN_BUTTON): uart_button.CONFIG_SCHEMA,
-            cv.Optional(CONF_PRESET1_BUTTON): uart_button.CONFIG_SCHEMA,
-            cv.Optional(CONF_PRESET2_BUTTON): uart_button.CONFIG_SCHEMA,
-            cv.Optional(CONF_PRESET3_BUTTON): uart_button.CONFIG_SCHEMA,
-            cv.Optional(CONF_MEMORY_BUTTON): uart_button.CONFIG_SCHEMA,
-            cv.Optional(CONF_TIMER_BUTTON): uart_button.CONFIG_SCHEMA,
+            cv.Optional(CONF_VELOCITY): sensor.sensor_schema(
+                unit_of_measurement=UNIT_CENTIMETER_PER_SECOND,
+                accuracy_decimals=1,
+                state_class=STATE_CLASS_MEASUREMENT,
+                icon=ICON_SPEEDOMETER,
+            ),
+            cv.Optional(CONF_ETA): sensor.sensor_schema(
+                unit_of_measurement=UNIT_SECOND,
+                accuracy_decimals=1,
+                device_class=DEVICE_CLASS_DURATION,
+                state_class=STATE_CLASS_MEASUREMENT,
+                icon=ICON_TIMER_SAND,
+            ),
+            **{
+                cv.Optional(key): sensor.sensor_schema(
+                    unit_of_measurement=UNIT_CENTIMETER,
+                    accuracy_decimals=1,
+                    device_class=DEVICE_CLASS_DISTANCE,
+                    icon=ICON_ARROW_EXPAND_VERTICAL,
+                )
+                for key in CONF_PRESET_HEIGHTS
+            },
+            cv.Optional(CONF_DIRECTION): text_sensor.text_sensor_schema(
+                icon=ICON_SWAP_VERTICAL
+            ),
+            **{cv.Optional(key): DESK_BUTTON_SCHEMA for key in DESK_BUTTONS},
+            cv.Optional(CONF_TIMER_FAST_SET, default=True): cv.boolean,
+            cv.Optional(CONF_COUNT_ALLOCATIONS, default=False): cv.boolean,
+            cv.Optional(CONF_FLIGHT_RECORDER_SIZE): cv.int_range(min=64, max=16384),
+            cv.Optional(CONF_TRANSITION_TRACE_SIZE): cv.int_range(min=8, max=1024),
+            cv.Optional(CONF_DIAGNOSTICS_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+            **{cv.Optional(key): schema for key, schema in DIAGNOSTIC_SENSORS.items()},
+            cv.Optional(CONF_STANDING_HEIGHT, default=95): cv.float_range(min=60, max=135),
+            cv.Optional(CONF_USAGE_PUBLISH_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_USAGE_SAVE_INTERVAL, default="1h"): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(min=cv.TimePeriod(minutes=1)),
+            ),
+            **{cv.Optional(key): schema for key, schema in USAGE_SENSORS.items()},
             cv.Optional(CONF_ON_TIMER_DONE_ACTION): automation.validate_automation(
                 {
                     cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(LoctekMotionOnTimerDoneTrigger),
                 }
             ),
+            cv.Optional(CONF_ON_MOVE_TO_HEIGHT_DONE_ACTION): automation.validate_automation(
+                {
+                    cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(LoctekMotionOnMoveToHeightDoneTrigger),
+                }
+            ),
+            cv.Optional(CONF_ON_FRAME): cv.All(
+                automation.validate_automation(
+                    {
+                        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(LoctekMotionOnFrameTrigger),
+                        cv.Required(CONF_TYPE): cv.hex_uint8_t,
+                    }
+                ),
+                validate_frame_types,
+            ),
         }
     ).extend(uart.UART_DEVICE_SCHEMA)
 )
@@ -142,64 +434,110 @@ async def to_code(config):
         cg.add(var.set_timer_active_binary_sensor(sens))
 
     if control_status_conf := config.get(CONF_CONTROL_STATUS):
+        cg.add_define("USE_LOCTEKMOTION_DESK_CONTROL_STATUS")
         sens = await text_sensor.new_text_sensor(control_status_conf)
         cg.add(var.set_control_status_text_sensor(sens))
 
     if height_conf := config.get(CONF_HEIGHT):
         sens = await sensor.new_sensor(height_conf)
         cg.add(var.set_height_sensor(sens))
+        cg.add(var.set_height_publish_interval(height_conf[CONF_PUBLISH_INTERVAL]))
 
     if timer_conf := config.get(CONF_TIMER):
+        cg.add_define("USE_LOCTEKMOTION_DESK_TIMER_SENSOR")
         sens = await sensor.new_sensor(timer_conf)
         cg.add(var.set_timer_sensor(sens))
 
-    up_button = await new_uart_button(config, CONF_UP_BUTTON)
-    if up_button:
-        cg.add(var.set_up_button(up_button))
-
-    down_button = await new_uart_button(config, CONF_DOWN_BUTTON)
-    if down_button:
-        cg.add(var.set_down_button(down_button))
-
-    preset1_button = await new_uart_button(config, CONF_PRESET1_BUTTON)
-    if preset1_button:
-        cg.add(var.set_preset1_button(preset1_button))
-
-    preset2_button = await new_uart_button(config, CONF_PRESET2_BUTTON)
-    if preset2_button:
-        cg.add(var.set_preset2_button(preset2_button))
-
-    preset3_button = await new_uart_button(config, CONF_PRESET3_BUTTON)
-    if preset3_button:
-        cg.add(var.set_preset3_button(preset3_button))
-
-    memory_button = await new_uart_button(config, CONF_MEMORY_BUTTON)
-    if memory_button:
-        cg.add(var.set_memory_button(memory_button))
-
-    timer_button = await new_uart_button(config, CONF_TIMER_BUTTON)
-    if timer_button:
-        cg.add(var.set_timer_button(timer_button))
+    if any(key in config for key in (CONF_VELOCITY, CONF_ETA, CONF_DIRECTION)):
+        cg.add_define("USE_LOCTEKMOTION_DESK_MOTION_SENSORS")
+        cg.add_define("USE_LOCTEKMOTION_DESK_VELOCITY")
+
+    if velocity_conf := config.get(CONF_VELOCITY):
+        sens = await sensor.new_sensor(velocity_conf)
+        cg.add(var.set_velocity_sensor(sens))
+
+    if eta_conf := config.get(CONF_ETA):
+        sens = await sensor.new_sensor(eta_conf)
+        cg.add(var.set_eta_sensor(sens))
+
+    if direction_conf := config.get(CONF_DIRECTION):
+        sens = await text_sensor.new_text_sensor(direction_conf)
+        cg.add(var.set_direction_text_sensor(sens))
+
+    if any(key in config for key in CONF_PRESET_HEIGHTS):
+        cg.add_define("USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS")
+        for preset, key in enumerate(CONF_PRESET_HEIGHTS, start=1):
+            if preset_conf := config.get(key):
+                sens = await sensor.new_sensor(preset_conf)
+                cg.add(var.set_preset_height_sensor(preset, sens))
+
+    # tells the preferences of several desks apart
+    preferences_hash = int(hashlib.md5(config[CONF_ID].id.encode()).hexdigest()[:8], 16)
+    cg.add(var.set_preferences_hash(preferences_hash))
+
+    for config_name, (default_keys, priority) in DESK_BUTTONS.items():
+        if button_conf := config.get(config_name):
+            await new_desk_button(var, button_conf, default_keys, priority)
+
+    cg.add(var.set_timer_fast_set(config[CONF_TIMER_FAST_SET]))
+
+    if config[CONF_COUNT_ALLOCATIONS]:
+        cg.add_define("USE_LOCTEKMOTION_DESK_ALLOCATION_COUNTER")
+
+    if flight_recorder_size := config.get(CONF_FLIGHT_RECORDER_SIZE):
+        cg.add_define("USE_LOCTEKMOTION_DESK_FLIGHT_RECORDER")
+        cg.add(var.set_flight_recorder_size(flight_recorder_size))
+    if transition_trace_size := config.get(CONF_TRANSITION_TRACE_SIZE):
+        cg.add_define("USE_LOCTEKMOTION_DESK_TRANSITION_TRACE")
+        cg.add(var.set_transition_trace_size(transition_trace_size))
+
+    if any(key in config for key in DIAGNOSTIC_SENSORS):
+        cg.add_define("USE_LOCTEKMOTION_DESK_DIAGNOSTICS")
+        cg.add(var.set_diagnostics_interval(config[CONF_DIAGNOSTICS_INTERVAL]))
+        for key in DIAGNOSTIC_SENSORS:
+            if sensor_conf := config.get(key):
+                sens = await sensor.new_sensor(sensor_conf)
+                cg.add(getattr(var, f"set_{key}_sensor")(sens))
+
+    if any(key in config for key in USAGE_SENSORS):
+        cg.add_define("USE_LOCTEKMOTION_DESK_USAGE_STATISTICS")
+        cg.add(var.set_standing_height(config[CONF_STANDING_HEIGHT]))
+        cg.add(var.set_usage_publish_interval(config[CONF_USAGE_PUBLISH_INTERVAL]))
+        cg.add(var.set_usage_save_interval(config[CONF_USAGE_SAVE_INTERVAL]))
+        for key in USAGE_SENSORS:
+            if sensor_conf := config.get(key):
+                sens = await sensor.new_sensor(sensor_conf)
+                cg.add(getattr(var, f"set_{key}_sensor")(sens))
 
     if actions := config.get(CONF_ON_TIMER_DONE_ACTION, []):
         for action in actions:
             trigger = cg.new_Pvariable(action[CONF_TRIGGER_ID], var)
             await automation.build_automation(trigger, [], action)
 
+    if actions := config.get(CONF_ON_MOVE_TO_HEIGHT_DONE_ACTION, []):
+        add_move_to_height_defines()
+        for action in actions:
+            trigger = cg.new_Pvariable(action[CONF_TRIGGER_ID], var)
+            await automation.build_automation(trigger, [(cg.float_, "x")], action)
+
+    for action in config.get(CONF_ON_FRAME, []):
+        trigger = cg.new_Pvariable(action[CONF_TRIGGER_ID], var, action[CONF_TYPE])
+        await automation.build_automation(trigger, [(FramePayload, "x")], action)
+
     cg.add(var.dump_config())
 
-async def new_uart_button(config, config_name, *args):
-    if button_conf := config.get(config_name):
-        var = await button.new_button(button_conf)        
-        await uart.register_uart_device(var, config)
+def add_move_to_height_defines():
+    cg.add_define("USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT")
+    cg.add_define("USE_LOCTEKMOTION_DESK_VELOCITY")
 
-        data = button_conf[CONF_DATA]
-        if isinstance(data, bytes):
-            data = [HexInt(x) for x in data]
-        cg.add(var.set_data(data))
+async def new_desk_button(parent, config, default_keys, priority):
+    var = await button.new_button(config)
+    await cg.register_parented(var, parent)
 
-        return var
-    return None
+    keys = config.get(CONF_KEY, config.get(CONF_DATA, validate_keys(default_keys)))
+    cg.add(var.set_keys(keys))
+    cg.add(var.set_priority(priority))
+    return var
 
 @automation.register_action(
     "loctekmotion_desk.timer_set",
@@ -213,8 +551,88 @@ async def new_uart_button(config, config_name, *args):
     ),    
 )
 async def timer_set_to_code(config, action_id, template_arg, args):
+    cg.add_define("USE_LOCTEKMOTION_DESK_TIMER_SET")
     var = cg.new_Pvariable(action_id, template_arg)
     await cg.register_parented(var, config[CONF_ID])
     duration = await cg.templatable(config[CONF_DURATION], args, int)
     cg.add(var.set_duration(duration))
-    return var
\ No newline at end of file
+    return var
+
+@automation.register_action(
+    "loctekmotion_desk.move_to_height",
+    LoctekMotionMoveToHeightAction,
+    cv.maybe_simple_value(
+        {
+            cv.GenerateID(): cv.use_id(LoctekMotionComponent),
+            cv.Required(CONF_HEIGHT): cv.templatable(cv.float_range(min=50, max=150)),
+        },
+        key=CONF_HEIGHT,
+    ),
+)
+async def move_to_height_to_code(config, action_id, template_arg, args):
+    add_move_to_height_defines()
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    height = await cg.templatable(config[CONF_HEIGHT], args, float)
+    cg.add(var.set_height(height))
+    return var
+
+@automation.register_action(
+    "loctekmotion_desk.press_key",
+    LoctekMotionPressKeyAction,
+    cv.maybe_simple_value(
+        {
+            cv.GenerateID(): cv.use_id(LoctekMotionComponent),
+            cv.Required(CONF_KEY): validate_keys,
+        },
+        key=CONF_KEY,
+    ),
+)
+async def press_key_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    cg.add(var.set_keys(config[CONF_KEY]))
+    cg.add(var.set_priority(key_priority(config[CONF_KEY])))
+    return var
+
+@automation.register_action(
+    "loctekmotion_desk.stop",
+    LoctekMotionStopAction,
+    automation.maybe_simple_id(
+        {
+            cv.GenerateID(): cv.use_id(LoctekMotionComponent),
+        }
+    ),
+)
+async def stop_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
+
+@automation.register_action(
+    "loctekmotion_desk.flight_recorder_dump",
+    LoctekMotionDumpFlightRecorderAction,
+    automation.maybe_simple_id(
+        {
+            cv.GenerateID(): cv.use_id(LoctekMotionComponent),
+        }
+    ),
+)
+async def flight_recorder_dump_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
+
+@automation.register_action(
+    "loctekmotion_desk.transition_trace_dump",
+    LoctekMotionDumpTransitionTraceAction,
+    automation.maybe_simple_id(
+        {
+            cv.GenerateID(): cv.use_id(LoctekMotionComponent),
+        }
+    ),
+)
+async def transition_trace_dump_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
@@ -22,6 +22,37 @@ namespace esphome
       }
     };
 
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+    class LoctekMotionOnMoveToHeightDoneTrigger : public Trigger<float>
+    {
+    public:
+      LoctekMotionOnMoveToHeightDoneTrigger(LoctekMotionComponent *desk)
+      {
+        desk->add_on_move_to_height_done_callback(
+            [this](float height)
+            {
+              this->stop_action(); // stop any previous running actions
+              this->trigger(height);
+            });
+      }
+    };
+#endif
+
+    class LoctekMotionOnFrameTrigger : public Trigger<FramePayload>
+    {
+    public:
+      LoctekMotionOnFrameTrigger(LoctekMotionComponent *desk, uint8_t type)
+      {
+        desk->add_frame_handler(
+            type,
+            [this](const DataFrame &frame)
+            {
+              this->trigger(FramePayload(frame));
+            });
+      }
+    };
+
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
     template <typename... Ts>
     class LoctekMotionSetTimerAction : public Action<Ts...>, public Parented<LoctekMotionComponent>
     {
@@ -30,5 +61,52 @@ namespace esphome
 
       void play(Ts... x) override { this->parent_->set_timer_duration(this->duration_.value(x...)); }
     };
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+    template <typename... Ts>
+    class LoctekMotionMoveToHeightAction : public Action<Ts...>, public Parented<LoctekMotionComponent>
+    {
+    public:
+      TEMPLATABLE_VALUE(float, height)
+
+      void play(Ts... x) override { this->parent_->move_to_height(this->height_.value(x...)); }
+    };
+#endif
+
+    template <typename... Ts>
+    class LoctekMotionPressKeyAction : public Action<Ts...>, public Parented<LoctekMotionComponent>
+    {
+    public:
+      void set_keys(uint8_t keys) { this->keys_ = keys; }
+      void set_priority(TxPriority priority) { this->priority_ = priority; }
+
+      void play(Ts... x) override { this->parent_->press_keys(this->keys_, this->priority_); }
+
+    protected:
+      uint8_t keys_{KEY_NONE};
+      TxPriority priority_{TX_PRIORITY_MOTION};
+    };
+
+    template <typename... Ts>
+    class LoctekMotionStopAction : public Action<Ts...>, public Parented<LoctekMotionComponent>
+    {
+    public:
+      void play(Ts... x) override { this->parent_->stop(); }
+    };
+
+    template <typename... Ts>
+    class LoctekMotionDumpFlightRecorderAction : public Action<Ts...>, public Parented<LoctekMotionComponent>
+    {
+    public:
+      void play(Ts... x) override { this->parent_->dump_flight_recorder(); }
+    };
+
+    template <typename... Ts>
+    class LoctekMotionDumpTransitionTraceAction : public Action<Ts...>, public Parented<LoctekMotionComponent>
+    {
+    public:
+      void play(Ts... x) override { this->parent_->dump_transition_trace(); }
+    };
   } // namespace loctekmotion_desk
 } // namespace esphome
\ No newline at end of file
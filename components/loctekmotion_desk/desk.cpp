@@ -2,237 +2,780 @@
 #include "automation.h"
 #include "esphome/core/log.h"
 
+#include <cinttypes>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
 namespace esphome {
 namespace loctekmotion_desk {
 
 static const char *const TAG = "loctekmotion_desk";
 
+static const uint32_t CONNECTION_TIMEOUT_MS = 1000;       // no data for this long means disconnected
+static const uint32_t CONNECTION_CHECK_INTERVAL_MS = 500;
+
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SENSOR
+static const uint32_t TIMER_TICK_INTERVAL_MS = 1000;
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_VELOCITY
+static const uint32_t VELOCITY_MAX_SAMPLE_INTERVAL_MS = 1000; // slower height changes mean the desk is stationary
+static const float VELOCITY_SMOOTHING = 0.5;
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_MOTION_SENSORS
+static const uint32_t MOTION_PUBLISH_INTERVAL_MS = 500; // rate limit of the motion sensors while moving
+static const float MOTION_ETA_MIN_VELOCITY = 0.5;      // cm/s, ETA is unknown when moving slower than this
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+static const uint32_t MOVE_PRESS_INTERVAL_MS = 108;   // repeat key frames to keep the desk moving
+static const uint32_t MOVE_START_TIMEOUT_MS = 3000;   // give up if the height does not change after pressing
+static const uint32_t MOVE_SETTLE_TIME_MS = 600;      // height unchanged for this long after release means stopped
+static const float MOVE_HEIGHT_TOLERANCE = 0.2;       // cm
+static const uint8_t MOVE_MAX_ATTEMPTS = 3;           // initial move plus corrections
+static const float MOVE_MIN_LEARNING_VELOCITY = 1.0;  // cm/s, don't learn stop latency from slow moves
+static const float MOVE_MAX_STOP_LATENCY = 1.0;       // s
+static const float MOVE_STOP_LATENCY_LEARNING_RATE = 0.3;
+#endif
+
+static const uint32_t TX_FRAME_INTERVAL_MS = 108;  // controller accepts one key frame per display frame slot
+static const uint32_t TX_MAX_FRAME_AGE_MS = 1000; // drop key frames that could not be sent in time
+
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
+static const uint32_t TIMER_STEP_INTERVAL_MS = 108;     // wait after the display changed before the next single press
+static const uint32_t TIMER_HOLD_PRESS_INTERVAL_MS = 108; // repeat key frames so the controller sees a held key
+static const uint32_t TIMER_HOLD_STALL_MS = 1000;       // duration not changing while held means the key does not repeat
+static const uint8_t TIMER_HOLD_MARGIN = 3;             // minutes, release and step one at a time this close to the target
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+static const uint32_t PRESET_HEIGHTS_PREFERENCE_SALT = 0x50524553; // "PRES"
+static const uint32_t PRESET_LEARNING_START_TIMEOUT_MS = 3000; // desk not moving after a preset press: not learning
+static const uint32_t PRESET_SAVE_DELAY_MS = 10000; // coalesce changes, e.g. saving all presets in a row, into one write
+static const float PRESET_HEIGHT_TOLERANCE = 0.05;  // cm, smaller differences are not written
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+static const uint32_t USAGE_STATISTICS_PREFERENCE_SALT = 0x55534147; // "USAG"
+static const uint32_t USAGE_MOTOR_MAX_SAMPLE_INTERVAL_MS = 1000; // slower height changes are not counted as motor time
+#endif
+
 void log_data_frame(const struct DataFrame *frame, size_t length = 0) {
-  std::string res;
-  char buf[5];
+  // formatted on the stack to keep the receive path free of heap allocations
+  char res[DATA_FRAME_MAX_SIZE * 3];
   size_t len = length > 0 ? length : frame->size();
+  if (len > DATA_FRAME_MAX_SIZE)
+    len = DATA_FRAME_MAX_SIZE;
+  size_t pos = 0;
   for (size_t i = 0; i < len; i++) {
     if (i > 0) {
-      res += ':';
-    }
-    sprintf(buf, "%02X", frame->raw[i]);
-    res += buf;
-  }
-  ESP_LOGD(TAG, "Data Frame: %s", res.c_str());
-}
-
-const std::string desk_control_state_to_string(DeskControlState state) {
-    switch (state) {
-        case DC_STATE_OFF: return "OFF";
-        case DC_STATE_MEMORY: return "MEMORY";
-        case DC_STATE_HEIGHT: return "HEIGHT";
-        case DC_STATE_MOVING: return "MOVING";
-        case DC_STATE_TIMER_STARTING: return "TIMER_STARTING";
-        case DC_STATE_TIMER_CHANGE: return "TIMER_CHANGE";
-        case DC_STATE_TIMER_ON: return "TIMER_ON";
-        case DC_STATE_TIMER_OFF: return "TIMER_OFF";
-        case DC_STATE_TIMER_MOVING: return "TIMER_MOVING";
-        case DC_STATE_TIMER_DONE: return "TIMER_DONE";
-        default: return "UNKNOWN";
+      res[pos++] = ':';
     }
+    pos += snprintf(&res[pos], sizeof(res) - pos, "%02X", frame->raw[i]);
+  }
+  res[pos] = 0;
+  ESP_LOGD(TAG, "Data Frame: %s", res);
+}
+
+#ifdef USE_LOCTEKMOTION_DESK_CONTROL_STATUS
+static const char *const DESK_CONTROL_STATE_NAMES[DC_STATE_COUNT] = {
+  "UNKNOWN",
+  "OFF",
+  "MEMORY",
+  "HEIGHT",
+  "MOVING",
+  "TIMER_STARTING",
+  "TIMER_CHANGE",
+  "TIMER_ON",
+  "TIMER_OFF",
+  "TIMER_MOVING",
+  "TIMER_DONE",
+};
+
+/**
+ * Gets state name to publish. Names are short enough to fit std::string's small buffer
+ * and not allocate on the heap.
+ */
+const char *desk_control_state_name(DeskControlState state) {
+  return state < DC_STATE_COUNT ? DESK_CONTROL_STATE_NAMES[state] : DESK_CONTROL_STATE_NAMES[DC_STATE_UNKNOWN];
 }
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_ALLOCATION_COUNTER
+// debug build only: count heap allocations made through operator new
+static uint32_t heap_allocations = 0;
+#endif
 
 // ---------------------------------
 
 LoctekMotionComponent::LoctekMotionComponent(uart::UARTComponent *uart) : uart::UARTDevice(uart) {
-
+  this->frame_handlers_.add(DATA_TYPE_DISPLAY, [this](const DataFrame &frame) { this->handle_display_frame_(frame); });
+  // defaults, replaced by the handlers of on_frame or add_frame_handler()
+  this->frame_handlers_.add_default(DATA_TYPE_BEEP, [](const DataFrame &) { ESP_LOGD(TAG, "Controller beeped"); });
+  // known, but nothing to decode yet. registered without a handler so they are neither logged nor counted
+  this->frame_handlers_.add_default(DATA_TYPE_UNKNOWN_11, nullptr);
+  this->frame_handlers_.add_default(DATA_TYPE_UNKNOWN_15, nullptr);
 }
 
 void LoctekMotionComponent::dump_config() {
   ESP_LOGCONFIG(TAG, "Loctek Motion Desk");
   LOG_BINARY_SENSOR("  ", "Connection", this->connected_binary_sensor_);
   LOG_BINARY_SENSOR("  ", "Moving", this->moving_binary_sensor_);
+#ifdef USE_LOCTEKMOTION_DESK_FLIGHT_RECORDER
+  if (this->flight_recorder_size_ > 0)
+    ESP_LOGCONFIG(TAG, "  Flight Recorder: %u bytes", (unsigned) this->flight_recorder_size_);
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_TRANSITION_TRACE
+  if (this->transition_trace_size_ > 0)
+    ESP_LOGCONFIG(TAG, "  Transition Trace: %u records", (unsigned) this->transition_trace_size_);
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+  if (this->has_diagnostics_sensors_())
+    ESP_LOGCONFIG(TAG, "  Diagnostics Interval: %" PRIu32 " ms", this->diagnostics_interval_);
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+  if (this->has_preset_height_sensors_()) {
+    for (uint8_t i = 0; i < PRESET_COUNT; i++) {
+      ESP_LOGCONFIG(TAG, "  Preset %u Height: %.1f cm", i + 1, this->preset_heights_.heights[i]);
+    }
+  }
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+  if (this->has_usage_sensors_()) {
+    ESP_LOGCONFIG(TAG, "  Standing Height: %.1f cm", this->standing_height_);
+    ESP_LOGCONFIG(TAG, "  Usage Publish Interval: %" PRIu32 " ms", this->usage_publish_interval_);
+    ESP_LOGCONFIG(TAG, "  Usage Save Interval: %" PRIu32 " ms", this->usage_save_interval_);
+  }
+#endif
   this->check_uart_settings(9600);
 }
 
-void LoctekMotionComponent::setup() { }
+void LoctekMotionComponent::setup() {
+  this->data_reader.reset();
+  // the defines only compile features in for all desks. each desk runs the ones it has sensors or buffers for
+#ifdef USE_LOCTEKMOTION_DESK_FLIGHT_RECORDER
+  if (this->flight_recorder_size_ > 0)
+    this->flight_recorder_.init(this->flight_recorder_size_);
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_TRANSITION_TRACE
+  if (this->transition_trace_size_ > 0)
+    this->state_machine.trace().init(this->transition_trace_size_);
+#endif
+
+  // checked from the scheduler, so the loop() has nothing to do while the controller is silent
+  if (this->connected_binary_sensor_) {
+    this->set_interval("connection", CONNECTION_CHECK_INTERVAL_MS, [this]() { this->update_connected_binary_sensor_(); });
+  }
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SENSOR
+  this->schedule_timer_ticks_();
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+  this->diagnostics_enabled_ = this->has_diagnostics_sensors_();
+  if (this->diagnostics_enabled_) {
+    this->diagnostics_time_ = millis();
+    this->set_interval("diagnostics", this->diagnostics_interval_, [this]() { this->publish_diagnostics_(); });
+  }
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+  this->preset_heights_enabled_ = this->has_preset_height_sensors_();
+  if (this->preset_heights_enabled_)
+    this->setup_preset_heights_();
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+  this->usage_statistics_enabled_ = this->has_usage_sensors_();
+  if (this->usage_statistics_enabled_)
+    this->setup_usage_statistics_();
+#endif
+}
+
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+void LoctekMotionComponent::setup_preset_heights_() {
+  this->preset_heights_pref_ = global_preferences->make_preference<PresetHeights>(
+      this->preferences_hash_ ^ PRESET_HEIGHTS_PREFERENCE_SALT);
+  if (!this->preset_heights_pref_.load(&this->preset_heights_)) {
+    this->preset_heights_ = PresetHeights{};
+  }
+  for (uint8_t i = 0; i < PRESET_COUNT; i++) {
+    if (this->preset_height_sensors_[i] && this->preset_heights_.heights[i] > 0)
+      this->preset_height_sensors_[i]->publish_state(this->preset_heights_.heights[i]);
+  }
+}
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+void LoctekMotionComponent::setup_usage_statistics_() {
+  this->usage_statistics_pref_ = global_preferences->make_preference<UsageTotals>(
+      this->preferences_hash_ ^ USAGE_STATISTICS_PREFERENCE_SALT);
+  UsageTotals usage_totals{};
+  if (this->usage_statistics_pref_.load(&usage_totals)) {
+    this->usage_statistics_.restore(usage_totals);
+  }
+  this->publish_usage_statistics_();
+  this->set_interval("usage", this->usage_publish_interval_, [this]() { this->publish_usage_statistics_(); });
+  // accumulated in RAM, written to flash rarely
+  this->set_interval("usage_save", this->usage_save_interval_, [this]() { this->save_usage_statistics_(); });
+}
+#endif
+
+void LoctekMotionComponent::on_shutdown() {
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+  // don't lose a change still waiting for the coalescing delay. preferences are synced after this
+  if (this->preset_heights_enabled_ && this->preset_heights_save_pending_) {
+    this->cancel_timeout("preset_heights");
+    this->save_preset_heights_();
+  }
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+  if (this->usage_statistics_enabled_) {
+    this->usage_statistics_.update(millis());
+    this->save_usage_statistics_();
+  }
+#endif
+}
+
+bool LoctekMotionComponent::has_pending_work_() const {
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+  if (this->move_phase_ != MOVE_IDLE)
+    return true;
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
+  if (this->timer_hold_direction_ != 0 || this->timer_step_time_ != 0)
+    return true;
+#endif
+  return !this->tx_queue_.empty();
+}
 
 void LoctekMotionComponent::loop() {
+  if (this->available() <= 0 && !this->has_pending_work_()) {
+    // idle: nothing received, nothing to send
+    return;
+  }
+
+#ifdef USE_LOCTEKMOTION_DESK_ALLOCATION_COUNTER
+  uint32_t heap_allocations_before = heap_allocations;
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+  uint32_t loop_start_us = this->diagnostics_enabled_ ? micros() : 0;
+#endif
+
+  // drain everything the UART has received so far, parsing as we go,
+  // so no complete frame is left waiting for the next loop
+  int available;
+  while ((available = this->available()) > 0) {
+    size_t len;
+    uint8_t *dest = this->rx_buffer_.write_region(&len);
+    if (len > (size_t) available)
+      len = available;
+    if (!this->read_array(dest, len))
+      break;
+    this->rx_buffer_.commit(len);
+    this->last_packet_time_ = millis();
+
+    this->scan_frames_();
+  }
+
+  if (this->connected_binary_sensor_ && !this->connected_binary_sensor_->state) {
+    // report reconnection right away rather than on the next check
+    this->update_connected_binary_sensor_();
+  }
+
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+  if (this->move_phase_ != MOVE_IDLE) {
+    this->update_move_to_height_();
+  }
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
+  if (this->timer_hold_direction_ != 0) {
+    this->update_timer_hold_();
+  }
+
+  if (this->timer_step_time_ != 0 && (int32_t) (millis() - this->timer_step_time_) >= 0) {
+    // press the button again to reach the target timer duration
+    this->timer_step_time_ = 0;
+    this->set_timer_duration(this->timer_target_duration_);
+  }
+#endif
+
+  if (!this->tx_queue_.empty()) {
+    this->process_tx_queue_();
+  }
+
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+  if (this->diagnostics_enabled_) {
+    uint32_t loop_time_us = micros() - loop_start_us;
+    this->diagnostics_.loop_passes++;
+    this->diagnostics_.loop_time_us += loop_time_us;
+    if (loop_time_us > this->diagnostics_.loop_time_max_us)
+      this->diagnostics_.loop_time_max_us = loop_time_us;
+  }
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_ALLOCATION_COUNTER
+  uint32_t loop_heap_allocations = heap_allocations - heap_allocations_before;
+  if (loop_heap_allocations > 0) {
+    ESP_LOGW(TAG, "%" PRIu32 " heap allocations in loop()", loop_heap_allocations);
+  }
+#endif
+}
+
+void LoctekMotionComponent::scan_frames_() {
   uint8_t incoming_byte;
-  while (available() > 0) {
-    if (read_byte(&incoming_byte)) {
-      this->last_packet_time_ = millis();
+  // bytes queued by the reader to be parsed again after an error go first
+  while (data_reader.pop_pending(&incoming_byte) || this->rx_buffer_.pop(&incoming_byte)) {
+    if (data_reader.put(incoming_byte)) {
+      // packet complete
+      //log_raw_data("Packet: ", data_reader.frame.raw, data_reader.data_index_)
+#ifdef USE_LOCTEKMOTION_DESK_FLIGHT_RECORDER
+      if (this->flight_recorder_size_ > 0)
+        this->flight_recorder_.record(millis(), data_reader.frame);
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+      this->diagnostics_.frames++;
+#endif
+      if (data_reader.repeat && !this->is_display_retrigger_due_()) {
+        // the display again, byte for byte: nothing to decode or transition
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+        this->diagnostics_.repeat_frames++;
+#endif
+        continue;
+      }
+      this->handle_frame_(data_reader.frame);
+    }
+  }
+}
 
-      if (data_reader.put(incoming_byte)) {
-        // packet complete
-        //log_raw_data("Packet: ", data_reader.frame.raw, data_reader.data_index_)
-        auto frame = data_reader.frame;
+/**
+ * An unchanged display is handled again once per second, so the state machine sees that the height stopped changing
+ */
+bool LoctekMotionComponent::is_display_retrigger_due_() const {
+  return millis() - this->desk_control_trigger_timestamps[this->decoded_display.state] >= 1000;
+}
 
-        if (frame.type == 0x11 || frame.type == 0x15) // skip unknown packet
-          return;
+void LoctekMotionComponent::handle_frame_(const DataFrame &frame) {
+  if (!this->frame_handlers_.dispatch(frame)) {
+    this->handle_unhandled_frame_(frame);
+  }
+}
 
-        if (frame.type == DATA_TYPE_DISPLAY) {
+bool LoctekMotionComponent::add_frame_handler(uint8_t type, FrameHandler &&handler) {
+  if (!this->frame_handlers_.add(type, std::move(handler))) {
+    ESP_LOGW(TAG, "Frame type 0x%02X already has a handler, or there are no free slots", type);
+    return false;
+  }
+  return true;
+}
 
-          bool display_changed = display.segment1 != frame.data[0]
-            ||  display.segment2 != frame.data[1]
-            ||  display.segment3 != frame.data[2];
+/**
+ * Counts frames nobody handles. Only the first frame of each type is logged, to help characterizing
+ * new types without paying for logging on every frame.
+ */
+void LoctekMotionComponent::handle_unhandled_frame_(const DataFrame &frame) {
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+  this->diagnostics_.unhandled_frames++;
+#endif
+  if (this->logged_frame_types_.insert(frame.type)) {
+    ESP_LOGD(TAG, "Unhandled frame type 0x%02X, further frames of this type are not logged", frame.type);
+    log_data_frame(&frame);
+  }
+}
 
-          // 9B:04:14:7F:03:9D when alarm beeped
-          // 9B:04:81:10:C3:9D 15 seconds after alarm beeped. also sometimes sent while the alarm timer is on e.g 7 minutes after alarm timer started
+void LoctekMotionComponent::handle_display_frame_(const DataFrame &frame) {
+  bool display_changed = display.segment1 != frame.data[0]
+    ||  display.segment2 != frame.data[1]
+    ||  display.segment3 != frame.data[2];
 
-          if (!display_changed) {
-            auto display_state = get_display_state(&display);
-            auto last_triggerred = millis() - desk_control_trigger_timestamps[display_state];
-            if (last_triggerred < 1000) {
-              // changed less then 1 second ago. don't retrigger
-              return;
-            }
-          }
+  if (!display_changed && !this->is_display_retrigger_due_()) {
+    // changed less then 1 second ago. don't retrigger
+    return;
+  }
 
-          display.segment1 = frame.data[0];
-          display.segment2 = frame.data[1];
-          display.segment3 = frame.data[2];
+  display.segment1 = frame.data[0];
+  display.segment2 = frame.data[1];
+  display.segment3 = frame.data[2];
 
-          auto display_state = get_display_state(&display);
+  // decode once per frame, the result is cached with the display
+  decoded_display = decode_display(&display);
+  auto display_state = decoded_display.state;
 
-          desk_control_trigger_timestamps[display_state] = millis();
+  desk_control_trigger_timestamps[display_state] = millis();
+
+  if (display_state != last_display_state) {
+
+    if (display_state == SD_STATE_UNKNOWN) {
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+      this->diagnostics_.unknown_frames++;
+#endif
+      log_data_frame(&frame);
+    } else {
+      // log_data_frame(&frame);
+    }
+  }
 
-          if (display_state != last_display_state) {
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SENSOR
+  auto previous_display_state = last_display_state;
+#endif
+#if defined(USE_LOCTEKMOTION_DESK_TIMER_SENSOR) || defined(USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS)
+  auto previous_state = state_machine.current_state();
+#endif
+#if defined(USE_LOCTEKMOTION_DESK_TIMER_SET) || defined(USE_LOCTEKMOTION_DESK_TIMER_SENSOR)
+  auto previous_duration = state_machine.timer_duration();
+#endif
+  last_display_state = display_state;
 
-            if (display_state == SD_STATE_UNKNOWN) {
-              log_data_frame(&frame);
+  switch (display_state)
+  {
+  case SD_STATE_HEIGHT:
+    {
+      float height = decoded_display.height;
+      state_machine.set_height(height);
+#ifdef USE_LOCTEKMOTION_DESK_VELOCITY
+      this->update_height_velocity_(height, millis());
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+      if (this->usage_statistics_enabled_)
+        this->update_usage_motor_time_(height, millis());
+#endif
+    }
+    break;
+  
+  case SD_STATE_TIMER_DURATION_ON:
+  case SD_STATE_TIMER_DURATION_ONLY:
+    {
+      state_machine.set_timer_duration(decoded_display.minutes);
+    }
+    break;
+
+  case SD_STATE_TIMER_OFF:
+    {
+      state_machine.set_timer_duration(0);
+    }
+    break;
+  default:
+    break;
+  }
+
+
+  if (state_machine.transition(display_state)) {
+    // state changed
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+    this->diagnostics_.transitions++;
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_CONTROL_STATUS
+    this->update_control_status_text_sensor_();
+#endif
+
+    switch (state_machine.current_state()) {
+      case DC_STATE_OFF:
+        is_timer_active_ = false;
+        if (this->timer_active_binary_sensor_) {    
+          this->timer_active_binary_sensor_->publish_state(false);
+        }
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
+        if (timer_target_duration_ > 0) {
+          // the display went off while waiting to set the timer
+          this->set_timer_duration(timer_target_duration_);
+        }
+#endif
+        break;
+      case DC_STATE_TIMER_ON:
+        is_timer_active_ = true;
+        if (this->timer_active_binary_sensor_) {    
+          this->timer_active_binary_sensor_->publish_state(true);
+        }
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
+        if (timer_target_duration_ > 0 && timer_target_duration_ != state_machine.timer_duration()) {
+          // change duration
+          this->set_timer_duration(timer_target_duration_);
+          break;
+        }
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SENSOR
+        if (previous_state == DC_STATE_TIMER_MOVING) {
+          // back from showing the height while the timer kept running
+          this->sync_calculated_timer_duration_(false);
+        } else {
+          // timer started
+          this->start_calculated_timer_duration_();
+        }
+#endif
+        break;
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
+      case DC_STATE_TIMER_STARTING:
+      case DC_STATE_TIMER_CHANGE:
+      case DC_STATE_HEIGHT:
+        if (timer_target_duration_ > 0) {
+          this->set_timer_duration(timer_target_duration_);
+        }
+        break;
+#endif
+      case DC_STATE_TIMER_DONE:
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+        if (this->usage_statistics_enabled_)
+          this->usage_statistics_.count_timer_completion();
+#endif
+        this->timer_done_callback_.call();
+        break;
+      case DC_STATE_TIMER_OFF:
+        is_timer_active_ = false;
+        if (this->timer_active_binary_sensor_) {    
+          this->timer_active_binary_sensor_->publish_state(false);
+        }
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SENSOR
+        this->update_calculated_timer_duration_();
+#endif
+        break;
+      default:
+        break;
+    }
+  } else {
+    switch (state_machine.current_state()) {
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
+      case DC_STATE_TIMER_CHANGE:
+        {
+          auto current_duration = state_machine.timer_duration();
+          if (timer_target_duration_ > 0 && current_duration != previous_duration) {
+            // duration on screen just changed. 
+            this->timer_hold_change_time_ = millis();
+            if (this->timer_hold_direction_ != 0) {
+              // still holding the key, release it once close to the target
+              this->set_timer_duration(this->timer_target_duration_);
+            } else if (current_duration != timer_target_duration_) {
+              // wait a bit and press the button again to reach the target
+              this->timer_step_time_ = millis() + TIMER_STEP_INTERVAL_MS;
             } else {
-              // log_data_frame(&frame);
+              // final call to start the timer
+              this->set_timer_duration(this->timer_target_duration_);
             }
           }
+        }
+        break;
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SENSOR
+      case DC_STATE_TIMER_ON:
+        {
+          auto current_duration = state_machine.timer_duration();
+          if (current_duration != previous_duration) {
+            // duration on screen just changed. sync calculated timer duration in case it drifted.
+            // if the panel was already showing the timer, the minute changed exactly on this frame
+            bool minute_changed = previous_display_state == SD_STATE_TIMER_DURATION_ON
+                               || previous_display_state == SD_STATE_TIMER_DURATION_ONLY
+                               || previous_display_state == SD_STATE_TIMER_DURATION_OFF;
+            this->sync_calculated_timer_duration_(minute_changed);
+            ESP_LOGD(TAG, "Timer display changed to %d minutes", current_duration);
+          }
+        }
+        break;
+#endif
+      default:
+        break;
+    }
+  }
 
-          last_display_state = display_state;
-          auto previous_duration = state_machine.timer_duration();
-
-          switch (display_state)
-          {
-          case SD_STATE_HEIGHT:
-            {
-              float height = get_display_height(&display);
-              state_machine.set_height(height);
-
-              if (this->height_sensor_ && this->height_sensor_->state != height) {
-                this->height_sensor_->publish_state(height);
-                // this is needed to stop multiple publish calls, because publish is delayed:
-                this->height_sensor_->state = height;
-              }
-            }
-            break;
-          
-          case SD_STATE_TIMER_DURATION_ON:
-          case SD_STATE_TIMER_DURATION_ONLY:
-            {
-              state_machine.set_timer_duration(get_alarm_minutes(&display));
-            }
-            break;
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+  if (this->preset_heights_enabled_)
+    this->update_preset_learning_(previous_state);
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+  if (this->usage_statistics_enabled_)
+    this->update_usage_posture_();
+#endif
 
-          case SD_STATE_TIMER_OFF:
-            {
-              state_machine.set_timer_duration(0);
-            }
-            break;
-          default:
-            break;
-          }
+  // published after the transition, so the first height of a move is already published as moving
+  this->update_height_sensor_();
+  this->update_moving_binary_sensor_();
+#ifdef USE_LOCTEKMOTION_DESK_MOTION_SENSORS
+  this->update_motion_sensors_();
+#endif
+}
 
+void LoctekMotionComponent::send_frame(const uint8_t *data, size_t length, TxPriority priority) {
+  switch (this->tx_queue_.push(data, length, priority, millis())) {
+    case TX_REPLACED:
+      ESP_LOGW(TAG, "Send queue is full, dropped a lower priority key frame");
+      break;
+    case TX_REJECTED:
+      ESP_LOGW(TAG, "Send queue is full, key frame dropped");
+      break;
+    default:
+      break;
+  }
+}
 
-          if (state_machine.transition(display_state)) {
-            // state changed
-            this->update_control_status_text_sensor_();
-
-            switch (state_machine.current_state()) {
-              case DC_STATE_OFF:
-                is_timer_active_ = false;
-                if (this->timer_active_binary_sensor_) {    
-                  this->timer_active_binary_sensor_->publish_state(false);
-                }
-                break;
-              case DC_STATE_TIMER_ON:
-                is_timer_active_ = true;
-                if (this->timer_active_binary_sensor_) {    
-                  this->timer_active_binary_sensor_->publish_state(true);
-                }
-                if (timer_target_duration_ > 0 && timer_target_duration_ != state_machine.timer_duration()) {
-                  // change duration
-                  this->set_timer_duration(timer_target_duration_);
-                } else {
-                  // timer started
-                  this->start_calculated_timer_duration_();
-                }
-                break;
-              case DC_STATE_TIMER_STARTING:
-              case DC_STATE_TIMER_CHANGE:
-              case DC_STATE_HEIGHT:
-                if (timer_target_duration_ > 0) {
-                  this->set_timer_duration(timer_target_duration_);
-                }
-                break;
-              case DC_STATE_TIMER_DONE:
-                this->timer_done_callback_.call();
-                break;
-              case DC_STATE_TIMER_OFF:
-                is_timer_active_ = false;
-                if (this->timer_active_binary_sensor_) {    
-                  this->timer_active_binary_sensor_->publish_state(false);
-                }
-                this->update_calculated_timer_duration_();
-                break;
-              default:
-                break;
-            }
-          } else {
-            switch (state_machine.current_state()) {
-              case DC_STATE_TIMER_CHANGE:
-                {
-                  auto current_duration = state_machine.timer_duration();
-                  if (timer_target_duration_ > 0 && current_duration != previous_duration) {
-                    // duration on screen just changed. 
-                    if (current_duration != timer_target_duration_) {
-                      // wait a bit and press the button again to reach the target
-                      this->set_timeout(108, [this]() { this->set_timer_duration(this->timer_target_duration_); });
-                    } else {
-                      // final call to start the timer
-                      this->set_timer_duration(this->timer_target_duration_);
-                    }
-                  }
-                }
-                break;
-              case DC_STATE_TIMER_ON:
-                {
-                  auto current_duration = state_machine.timer_duration();
-                  if (current_duration != previous_duration) {
-                    // duration on screen just changed. sync calculated timer duration in case it drifted
-                    this->start_calculated_timer_duration_();
-                    ESP_LOGD(TAG, "Timer display changed to %d minutes", current_duration);
-                  }
-                }
-                break;
-              default:
-                break;
-            }
-          }
+void LoctekMotionComponent::press_keys(uint8_t keys, TxPriority priority) {
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+  if (this->preset_heights_enabled_)
+    this->observe_key_press_(keys);
+#endif
+  KeyFrame frame = encode_key_frame(keys);
+  this->send_frame(frame.raw, KEY_FRAME_SIZE, priority);
+}
 
-          this->update_moving_binary_sensor_();
-        } else {
-          log_data_frame(&frame);
-        }
+void LoctekMotionComponent::process_tx_queue_() {
+  uint32_t now = millis();
+  if ((int32_t) (now - this->next_tx_time_) < 0)
+    return;
 
-        data_reader.reset();
-      }
-    }
+  size_t expired = this->tx_queue_.remove_older_than(now, TX_MAX_FRAME_AGE_MS);
+  if (expired > 0) {
+    ESP_LOGW(TAG, "Dropped %u key frames waiting more than %" PRIu32 " ms", (unsigned) expired, TX_MAX_FRAME_AGE_MS);
   }
 
-  this->update_connected_binary_sensor_();  
+  TxFrame frame;
+  if (this->tx_queue_.pop(&frame)) {
+    this->write_array(frame.data, frame.length);
+    this->next_tx_time_ = now + TX_FRAME_INTERVAL_MS;
+  }
+}
 
-  if (state_machine.current_state() == DC_STATE_TIMER_ON || state_machine.current_state() == DC_STATE_TIMER_DONE) {
-    this->update_calculated_timer_duration_();
+void LoctekMotionComponent::stop() {
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+  if (this->move_phase_ != MOVE_IDLE) {
+    ESP_LOGI(TAG, "Move to %.1f cm cancelled", this->move_target_height_);
+    this->move_phase_ = MOVE_IDLE;
   }
+#endif
+  this->tx_queue_.remove_priority(TX_PRIORITY_MOTION);
+  // no keys pressed. stops the desk immediately instead of waiting for it to notice the key was released
+  this->press_keys(KEY_NONE, TX_PRIORITY_STOP);
+}
+
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+bool LoctekMotionComponent::has_diagnostics_sensors_() const {
+  return this->frame_rate_sensor_ || this->crc_errors_sensor_ || this->framing_errors_sensor_ ||
+         this->dropped_bytes_sensor_ || this->unknown_frames_sensor_ || this->unhandled_frames_sensor_ ||
+         this->repeat_frames_sensor_ || this->transition_rate_sensor_ || this->loop_time_max_sensor_ ||
+         this->loop_time_avg_sensor_;
+}
+
+void LoctekMotionComponent::publish_diagnostics_() {
+  uint32_t now = millis();
+  uint32_t elapsed = now - this->diagnostics_time_;
+  if (elapsed == 0)
+    return;
+  const DeskDiagnostics &diagnostics = this->diagnostics_;
+  const DataFrameReaderErrors &errors = this->data_reader.errors();
+
+  if (this->frame_rate_sensor_)
+    this->frame_rate_sensor_->publish_state(diagnostics.frames * 1000.0f / elapsed);
+  if (this->crc_errors_sensor_)
+    this->crc_errors_sensor_->publish_state(errors.crc);
+  if (this->framing_errors_sensor_)
+    this->framing_errors_sensor_->publish_state(errors.framing + errors.length);
+  if (this->dropped_bytes_sensor_)
+    this->dropped_bytes_sensor_->publish_state(errors.dropped_bytes);
+  if (this->unknown_frames_sensor_)
+    this->unknown_frames_sensor_->publish_state(diagnostics.unknown_frames);
+  if (this->unhandled_frames_sensor_)
+    this->unhandled_frames_sensor_->publish_state(diagnostics.unhandled_frames);
+  if (this->repeat_frames_sensor_)
+    this->repeat_frames_sensor_->publish_state(
+        diagnostics.frames > 0 ? diagnostics.repeat_frames * 100.0f / diagnostics.frames : 0);
+  if (this->transition_rate_sensor_)
+    this->transition_rate_sensor_->publish_state(diagnostics.transitions * 60000.0f / elapsed);
+  if (this->loop_time_max_sensor_)
+    this->loop_time_max_sensor_->publish_state(diagnostics.loop_time_max_us);
+  if (this->loop_time_avg_sensor_)
+    this->loop_time_avg_sensor_->publish_state(
+        diagnostics.loop_passes > 0 ? (float) diagnostics.loop_time_us / diagnostics.loop_passes : 0);
+
+  // totals carry over, rates and loop times start a new period
+  this->diagnostics_ = DeskDiagnostics{0, 0, diagnostics.unknown_frames, diagnostics.unhandled_frames, 0, 0, 0, 0};
+  this->diagnostics_time_ = now;
+}
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+bool LoctekMotionComponent::has_usage_sensors_() const {
+  return this->sitting_time_sensor_ || this->standing_time_sensor_ || this->posture_changes_sensor_ ||
+         this->motor_up_time_sensor_ || this->motor_down_time_sensor_ || this->timer_completions_sensor_;
+}
+
+/**
+ * Counts the time between height changes as motor time. Heights change several times per second
+ * while moving, so longer gaps are the desk standing still between two moves.
+ */
+void LoctekMotionComponent::update_usage_motor_time_(float height, uint32_t now) {
+  if (height == this->usage_last_height_)
+    return;
+  uint32_t elapsed = now - this->usage_last_height_time_;
+  if (this->usage_last_height_ > 0 && elapsed <= USAGE_MOTOR_MAX_SAMPLE_INTERVAL_MS) {
+    this->usage_statistics_.add_motor_time(height > this->usage_last_height_ ? 1 : -1, elapsed);
+  }
+  this->usage_last_height_ = height;
+  this->usage_last_height_time_ = now;
+}
+
+/**
+ * Classifies the position of the desk whenever it's not moving. The last known height still holds
+ * while the display is off or shows the timer.
+ */
+void LoctekMotionComponent::update_usage_posture_() {
+  auto state = this->state_machine.current_state();
+  float height = this->state_machine.height();
+  if (state == DC_STATE_UNKNOWN || state == DC_STATE_MOVING || state == DC_STATE_TIMER_MOVING || height <= 0)
+    return;
+  this->usage_statistics_.set_posture(height >= this->standing_height_ ? POSTURE_STANDING : POSTURE_SITTING,
+                                      millis());
+}
+
+void LoctekMotionComponent::publish_usage_statistics_() {
+  if (this->last_packet_time_ == 0 || millis() - this->last_packet_time_ >= CONNECTION_TIMEOUT_MS) {
+    // the desk's position is unknown while the link is down, stop counting at the last frame
+    this->usage_statistics_.set_posture(POSTURE_UNKNOWN, this->last_packet_time_);
+  } else {
+    this->usage_statistics_.update(millis());
+  }
+
+  const UsageTotals &totals = this->usage_statistics_.totals();
+  if (this->sitting_time_sensor_)
+    this->sitting_time_sensor_->publish_state(totals.sitting_seconds / 3600.0f);
+  if (this->standing_time_sensor_)
+    this->standing_time_sensor_->publish_state(totals.standing_seconds / 3600.0f);
+  if (this->posture_changes_sensor_)
+    this->posture_changes_sensor_->publish_state(totals.posture_changes);
+  if (this->motor_up_time_sensor_)
+    this->motor_up_time_sensor_->publish_state(totals.motor_up_ms / 1000.0f);
+  if (this->motor_down_time_sensor_)
+    this->motor_down_time_sensor_->publish_state(totals.motor_down_ms / 1000.0f);
+  if (this->timer_completions_sensor_)
+    this->timer_completions_sensor_->publish_state(totals.timer_completions);
+}
+
+void LoctekMotionComponent::save_usage_statistics_() {
+  if (!this->usage_statistics_.take_changed())
+    return;
+  ESP_LOGD(TAG, "Saving usage statistics");
+  this->usage_statistics_pref_.save(&this->usage_statistics_.totals());
+}
+#endif
+
+void LoctekMotionComponent::dump_flight_recorder() const {
+#ifdef USE_LOCTEKMOTION_DESK_FLIGHT_RECORDER
+  this->flight_recorder_.dump();
+#else
+  ESP_LOGW(TAG, "Flight recorder is not enabled (set flight_recorder_size)");
+#endif
+}
+
+void LoctekMotionComponent::dump_transition_trace() const {
+#ifdef USE_LOCTEKMOTION_DESK_TRANSITION_TRACE
+  this->state_machine.trace().dump();
+  ESP_LOGI(TAG, "Control state is %s", LOG_STR_ARG(desk_control_state_to_string(this->state_machine.current_state())));
+#else
+  ESP_LOGW(TAG, "Transition trace is not enabled (set transition_trace_size)");
+#endif
 }
 
 void LoctekMotionComponent::update_connected_binary_sensor_() {
   if (this->connected_binary_sensor_) {
     uint32_t millis_since_last_packet = millis() - this->last_packet_time_;
-    if (millis_since_last_packet >= 1000) {
+    if (this->last_packet_time_ == 0 || millis_since_last_packet >= CONNECTION_TIMEOUT_MS) {
       // disconnected
       if (this->connected_binary_sensor_->state) {
         this->connected_binary_sensor_->publish_state(false);
@@ -250,17 +793,216 @@ void LoctekMotionComponent::update_connected_binary_sensor_() {
   }
 }
 
+bool LoctekMotionComponent::is_moving_() const {
+  return state_machine.current_state() == DC_STATE_MOVING
+      || state_machine.current_state() == DC_STATE_TIMER_MOVING;
+}
+
+void LoctekMotionComponent::update_height_sensor_() {
+  if (!this->height_sensor_)
+    return;
+  float height = state_machine.height();
+  if (height == 0)
+    return; // not known yet
+
+  bool currently_moving = this->is_moving_();
+  bool publish;
+  if (currently_moving) {
+    // every change while moving, optionally rate limited
+    publish = this->height_sensor_->state != height
+           && millis() - this->height_publish_time_ >= this->height_publish_interval_;
+  } else {
+    // the settled height once the desk stopped, even if it was already published while moving.
+    // otherwise only if it changed without moving, e.g. the first height after boot
+    publish = this->height_published_while_moving_ || this->height_sensor_->state != height;
+  }
+  this->height_published_while_moving_ = currently_moving;
+
+  if (publish) {
+    this->height_publish_time_ = millis();
+    this->height_sensor_->publish_state(height);
+    // this is needed to stop multiple publish calls, because publish is delayed:
+    this->height_sensor_->state = height;
+  }
+}
+
 void LoctekMotionComponent::update_moving_binary_sensor_() {
   if (this->moving_binary_sensor_) {
-    bool currently_moving = state_machine.current_state() == DC_STATE_MOVING
-                          || state_machine.current_state() == DC_STATE_TIMER_MOVING;
+    bool currently_moving = this->is_moving_();
     this->moving_binary_sensor_->publish_state(currently_moving);
   }
 }
 
+#ifdef USE_LOCTEKMOTION_DESK_MOTION_SENSORS
+void LoctekMotionComponent::update_motion_sensors_() {
+  if (!this->velocity_sensor_ && !this->eta_sensor_ && !this->direction_text_sensor_)
+    return;
+
+  bool currently_moving = this->is_moving_();
+  uint32_t now = millis();
+
+  if (!currently_moving) {
+    if (this->motion_published_) {
+      // publish the stopped state once, then stay quiet until the next move
+      this->motion_published_ = false;
+      if (this->velocity_sensor_)
+        this->velocity_sensor_->publish_state(0);
+      if (this->eta_sensor_)
+        this->eta_sensor_->publish_state(0);
+      if (this->direction_text_sensor_) {
+        this->direction_text_sensor_->publish_state("STOPPED");
+        this->direction_text_sensor_->state = "STOPPED";
+      }
+    }
+    return;
+  }
+
+  if (this->motion_published_ && now - this->motion_publish_time_ < MOTION_PUBLISH_INTERVAL_MS)
+    return;
+  if (this->height_velocity_ == 0)
+    return; // not enough height samples yet
+  this->motion_published_ = true;
+  this->motion_publish_time_ = now;
+
+  float velocity = this->height_velocity_;
+  if (this->velocity_sensor_)
+    this->velocity_sensor_->publish_state(velocity);
+
+  if (this->direction_text_sensor_) {
+    const char *direction = velocity > 0 ? "UP" : "DOWN";
+    if (this->direction_text_sensor_->state != direction) {
+      this->direction_text_sensor_->publish_state(direction);
+      // this is needed to stop multiple publish calls, because publish is delayed:
+      this->direction_text_sensor_->state = direction;
+    }
+  }
+
+  if (this->eta_sensor_) {
+    float target = this->motion_target_height_();
+    float remaining = (target - state_machine.height()) / velocity;
+    if (std::isnan(target) || fabsf(velocity) < MOTION_ETA_MIN_VELOCITY || remaining < 0) {
+      // no known target ahead
+      this->eta_sensor_->publish_state(NAN);
+    } else {
+      this->eta_sensor_->publish_state(remaining);
+    }
+  }
+}
+
+/**
+ * Gets the height the desk is currently heading to, or NAN when it's being moved manually.
+ */
+float LoctekMotionComponent::motion_target_height_() const {
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+  if (this->move_phase_ != MOVE_IDLE)
+    return this->move_target_height_;
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+  if (this->preset_learning_ == PRESET_LEARNING_MOVE)
+    return this->get_preset_height(this->preset_learning_index_ + 1);
+#endif
+  return NAN;
+}
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+bool LoctekMotionComponent::has_preset_height_sensors_() const {
+  for (auto *preset_height_sensor : this->preset_height_sensors_) {
+    if (preset_height_sensor)
+      return true;
+  }
+  return false;
+}
+
+float LoctekMotionComponent::get_preset_height(uint8_t preset) const {
+  if (preset < 1 || preset > PRESET_COUNT)
+    return NAN;
+  float height = this->preset_heights_.heights[preset - 1];
+  return height > 0 ? height : NAN;
+}
+
+/**
+ * Watches for presets being pressed, to learn their heights
+ */
+void LoctekMotionComponent::observe_key_press_(uint8_t keys) {
+  int8_t index = keys == KEY_PRESET1 ? 0 : keys == KEY_PRESET2 ? 1 : keys == KEY_PRESET3 ? 2 : -1;
+  if (index < 0) {
+    // anything else pressed meanwhile, e.g. up/down or stop, would end up at another height
+    this->preset_learning_ = PRESET_LEARNING_IDLE;
+    return;
+  }
+
+  if (this->state_machine.current_state() == DC_STATE_MEMORY) {
+    this->start_preset_learning_(PRESET_LEARNING_SAVE);
+  } else if (this->preset_learning_ != PRESET_LEARNING_MOVE || this->preset_learning_index_ != index) {
+    this->start_preset_learning_(PRESET_LEARNING_MOVE);
+  } else {
+    // pressing the same preset again, e.g. to retry, keeps waiting for the same move
+    this->preset_learning_time_ = millis();
+  }
+  this->preset_learning_index_ = index;
+}
+
+void LoctekMotionComponent::start_preset_learning_(PresetLearning learning) {
+  // nothing carries over from the previous learning, or its start timeout would not fire as it should
+  this->preset_learning_ = learning;
+  this->preset_learning_moved_ = false;
+  this->preset_learning_time_ = millis();
+}
+
+void LoctekMotionComponent::update_preset_learning_(DeskControlState previous_state) {
+  if (this->preset_learning_ == PRESET_LEARNING_IDLE)
+    return;
+  auto state = this->state_machine.current_state();
+
+  if (this->preset_learning_ == PRESET_LEARNING_SAVE) {
+    if (previous_state == DC_STATE_MEMORY && state != DC_STATE_MEMORY) {
+      // saved, the panel shows the height again
+      this->preset_learning_ = PRESET_LEARNING_IDLE;
+      this->learn_preset_height_(this->preset_learning_index_, this->state_machine.height());
+    }
+  } else if (this->is_moving_()) {
+    this->preset_learning_moved_ = true;
+  } else if (this->preset_learning_moved_) {
+    // the desk stops moving once the height has not changed for a while, so it has settled
+    this->preset_learning_ = PRESET_LEARNING_IDLE;
+    this->learn_preset_height_(this->preset_learning_index_, this->state_machine.height());
+    return;
+  }
+
+  if (!this->preset_learning_moved_ && millis() - this->preset_learning_time_ >= PRESET_LEARNING_START_TIMEOUT_MS) {
+    // the press was not taken, or the desk was already there. nothing to learn from
+    this->preset_learning_ = PRESET_LEARNING_IDLE;
+  }
+}
+
+void LoctekMotionComponent::learn_preset_height_(uint8_t index, float height) {
+  if (height <= 0)
+    return;
+  float &learned = this->preset_heights_.heights[index];
+  if (fabsf(learned - height) < PRESET_HEIGHT_TOLERANCE)
+    return;
+
+  ESP_LOGI(TAG, "Preset %u is at %.1f cm", index + 1, height);
+  learned = height;
+  if (this->preset_height_sensors_[index])
+    this->preset_height_sensors_[index]->publish_state(height);
+
+  // only written once changes stopped for a while
+  this->preset_heights_save_pending_ = true;
+  this->set_timeout("preset_heights", PRESET_SAVE_DELAY_MS, [this]() { this->save_preset_heights_(); });
+}
+
+void LoctekMotionComponent::save_preset_heights_() {
+  this->preset_heights_save_pending_ = false;
+  this->preset_heights_pref_.save(&this->preset_heights_);
+}
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_CONTROL_STATUS
 void LoctekMotionComponent::update_control_status_text_sensor_() {
   if (this->control_status_text_sensor_) {
-    std::string state = desk_control_state_to_string(state_machine.current_state());
+    const char *state = desk_control_state_name(state_machine.current_state());
     if (this->control_status_text_sensor_->state != state) {
       this->control_status_text_sensor_->publish_state(state);
       // this is needed to stop multiple publish calls, because publish is delayed:
@@ -268,25 +1010,222 @@ void LoctekMotionComponent::update_control_status_text_sensor_() {
     }
   }
 }
+#endif
 
-void LoctekMotionComponent::start_calculated_timer_duration_() {
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
+void LoctekMotionComponent::update_timer_hold_() {
+  uint32_t now = millis();
+  if (this->state_machine.current_state() != DC_STATE_TIMER_CHANGE || this->timer_target_duration_ == 0) {
+    // left the timer change mode, e.g. it timed out
+    this->timer_hold_direction_ = 0;
+    return;
+  }
+
+  if (now - this->timer_hold_change_time_ >= TIMER_HOLD_STALL_MS) {
+    ESP_LOGW(TAG, "Timer duration does not change while holding the key, disabling fast timer set");
+    this->timer_fast_set_ = false;
+    this->timer_hold_direction_ = 0;
+    // release the key first, so the next press is not taken as still holding it
+    this->timer_step_time_ = now + TIMER_STEP_INTERVAL_MS;
+    return;
+  }
+
+  if (now - this->timer_hold_press_time_ >= TIMER_HOLD_PRESS_INTERVAL_MS) {
+    this->timer_hold_press_time_ = now;
+    this->press_keys(this->timer_hold_direction_ > 0 ? KEY_UP : KEY_DOWN, TX_PRIORITY_TIMER);
+  }
+}
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SENSOR
+/**
+ * Ticks the timer sensor once per second. Created once, anchoring the countdown only moves timer_start_time_
+ */
+void LoctekMotionComponent::schedule_timer_ticks_() {
+  if (!this->timer_sensor_)
+    return;
+  this->set_interval("timer", TIMER_TICK_INTERVAL_MS, [this]() {
+    auto state = state_machine.current_state();
+    if (state == DC_STATE_TIMER_ON || state == DC_STATE_TIMER_MOVING || state == DC_STATE_TIMER_DONE) {
+      this->update_calculated_timer_duration_();
+    }
+  });
+}
+
+void LoctekMotionComponent::anchor_calculated_timer_duration_(uint32_t remaining_seconds) {
   timer_start_time_ = millis();
-  timer_total_seconds_ = state_machine.timer_duration() * 60;
+  timer_total_seconds_ = remaining_seconds;
+  this->update_calculated_timer_duration_();
+}
+
+void LoctekMotionComponent::start_calculated_timer_duration_() {
+  this->anchor_calculated_timer_duration_(state_machine.timer_duration() * 60);
+}
+
+/**
+ * Corrects the countdown with the minutes on the display. The panel rounds up, so M minutes means
+ * between (M-1)*60+1 and M*60 seconds remaining, and exactly M*60 on the frame where the minute changed.
+ */
+void LoctekMotionComponent::sync_calculated_timer_duration_(bool minute_changed) {
+  uint32_t max_remaining = state_machine.timer_duration() * 60;
+  uint32_t min_remaining = max_remaining > 0 ? max_remaining - 59 : 0;
+  uint32_t calculated = this->calculated_timer_remaining_();
+  uint32_t remaining = minute_changed ? max_remaining : calculated;
+  if (remaining > max_remaining)
+    remaining = max_remaining;
+  if (remaining < min_remaining)
+    remaining = min_remaining;
+  if (remaining != calculated) {
+    ESP_LOGD(TAG, "Timer countdown corrected by %" PRId32 " s", (int32_t) (remaining - calculated));
+  }
+  if (remaining != calculated || minute_changed) {
+    this->anchor_calculated_timer_duration_(remaining);
+  }
+}
+
+uint32_t LoctekMotionComponent::calculated_timer_remaining_() const {
+  // rounded, because the ticks are scheduled on whole seconds since the anchor
+  uint32_t elapsed = (millis() - timer_start_time_ + 500) / 1000;
+  return elapsed < timer_total_seconds_ ? timer_total_seconds_ - elapsed : 0;
 }
 
 void LoctekMotionComponent::update_calculated_timer_duration_() {
   if (!this->timer_sensor_)
     return;
   uint32_t timer = state_machine.timer_duration();
-  uint32_t timer_remaining = timer > 0 ? (timer_total_seconds_ - (millis() - timer_start_time_)/ 1000) : 0;
+  uint32_t timer_remaining = timer > 0 ? this->calculated_timer_remaining_() : 0;
   if (this->timer_sensor_->state != timer_remaining) {
     this->timer_sensor_->publish_state(timer_remaining);
     // this is needed to stop multiple publish calls, because publish is delayed:
     this->timer_sensor_->state = timer_remaining;
   }
 }
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_VELOCITY
+void LoctekMotionComponent::update_height_velocity_(float height, uint32_t now) {
+  uint32_t since_last_change = now - this->last_height_change_time_;
+  if (height == this->last_height_) {
+    if (since_last_change >= VELOCITY_MAX_SAMPLE_INTERVAL_MS) {
+      this->height_velocity_ = 0;
+    }
+    return;
+  }
+
+  if (this->last_height_ != 0 && since_last_change > 0 && since_last_change < VELOCITY_MAX_SAMPLE_INTERVAL_MS) {
+    float velocity = (height - this->last_height_) * 1000 / since_last_change;
+    this->height_velocity_ += VELOCITY_SMOOTHING * (velocity - this->height_velocity_);
+  } else {
+    // first change after being stationary
+    this->height_velocity_ = 0;
+  }
+  this->last_height_ = height;
+  this->last_height_change_time_ = now;
+}
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+void LoctekMotionComponent::move_to_height(float height) {
+  float current_height = this->state_machine.height();
+  if (current_height == 0) {
+    ESP_LOGW(TAG, "Current height is not known yet, wake the desk first");
+    return;
+  }
+
+  ESP_LOGD(TAG, "Moving from %.1f to %.1f cm", current_height, height);
+  this->move_target_height_ = height;
+  this->move_attempts_ = 0;
+  if (fabsf(height - current_height) <= MOVE_HEIGHT_TOLERANCE) {
+    this->finish_move_to_height_();
+    return;
+  }
+  this->move_direction_ = height > current_height ? 1 : -1;
+  this->move_phase_ = MOVE_PRESSING;
+  this->move_phase_start_time_ = millis();
+  this->move_last_press_time_ = this->move_phase_start_time_ - MOVE_PRESS_INTERVAL_MS;
+}
+
+bool LoctekMotionComponent::should_stop_moving_to_height_() const {
+  float remaining = (this->move_target_height_ - this->state_machine.height()) * this->move_direction_;
+  float predicted_coast = fabsf(this->height_velocity_) * this->move_stop_latency_;
+  return remaining - predicted_coast <= MOVE_HEIGHT_TOLERANCE / 2;
+}
+
+void LoctekMotionComponent::update_move_to_height_() {
+  uint32_t now = millis();
+  bool height_changed = (int32_t) (this->last_height_change_time_ - this->move_phase_start_time_) > 0;
+
+  if (this->move_phase_ == MOVE_SETTLING) {
+    if (now - this->move_phase_start_time_ >= MOVE_SETTLE_TIME_MS
+        && now - this->last_height_change_time_ >= MOVE_SETTLE_TIME_MS) {
+      this->finish_move_to_height_();
+    }
+    return;
+  }
+
+  if (this->should_stop_moving_to_height_()) {
+    // release the key, the desk will coast for a bit
+    this->move_phase_ = MOVE_SETTLING;
+    this->move_phase_start_time_ = now;
+    this->move_stop_height_ = this->state_machine.height();
+    this->move_stop_velocity_ = this->height_velocity_;
+    return;
+  }
+
+  if (!height_changed && now - this->move_phase_start_time_ >= MOVE_START_TIMEOUT_MS) {
+    ESP_LOGW(TAG, "Desk did not start moving");
+    this->finish_move_to_height_();
+    return;
+  }
+
+  auto state = this->state_machine.current_state();
+  if (state == DC_STATE_TIMER_STARTING || state == DC_STATE_TIMER_CHANGE || state == DC_STATE_MEMORY) {
+    // up and down would change the timer or the memory presets here
+    return;
+  }
+
+  if (now - this->move_last_press_time_ >= MOVE_PRESS_INTERVAL_MS) {
+    this->move_last_press_time_ = now;
+    this->press_keys(this->move_direction_ > 0 ? KEY_UP : KEY_DOWN, TX_PRIORITY_MOTION);
+  }
+}
+
+void LoctekMotionComponent::finish_move_to_height_() {
+  float height = this->state_machine.height();
 
+  if (this->move_phase_ == MOVE_SETTLING) {
+    float stop_speed = fabsf(this->move_stop_velocity_);
+    if (stop_speed >= MOVE_MIN_LEARNING_VELOCITY) {
+      float latency = fabsf(height - this->move_stop_height_) / stop_speed;
+      this->move_stop_latency_ += MOVE_STOP_LATENCY_LEARNING_RATE * (latency - this->move_stop_latency_);
+      if (this->move_stop_latency_ > MOVE_MAX_STOP_LATENCY)
+        this->move_stop_latency_ = MOVE_MAX_STOP_LATENCY;
+      ESP_LOGD(TAG, "Released at %.1f cm (%.1f cm/s), stopped at %.1f cm. Stop latency: %.2f s", this->move_stop_height_,
+               this->move_stop_velocity_, height, this->move_stop_latency_);
+    }
+
+    float error = height - this->move_target_height_;
+    if (fabsf(error) > MOVE_HEIGHT_TOLERANCE && ++this->move_attempts_ < MOVE_MAX_ATTEMPTS) {
+      // correct with a shorter move
+      this->move_direction_ = error < 0 ? 1 : -1;
+      this->move_phase_ = MOVE_PRESSING;
+      this->move_phase_start_time_ = millis();
+      this->move_last_press_time_ = this->move_phase_start_time_ - MOVE_PRESS_INTERVAL_MS;
+      return;
+    }
+  }
+
+  this->move_phase_ = MOVE_IDLE;
+  ESP_LOGI(TAG, "Moved to %.1f cm (target: %.1f cm)", height, this->move_target_height_);
+  this->move_to_height_done_callback_.call(height);
+}
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
 void LoctekMotionComponent::set_timer_duration(uint8_t duration) {
+  if (this->timer_target_duration_ == 0) {
+    this->timer_set_start_time_ = millis();
+  }
   auto state = this->state_machine.current_state();
   switch (state) {
     case DC_STATE_TIMER_OFF:
@@ -302,7 +1241,7 @@ void LoctekMotionComponent::set_timer_duration(uint8_t duration) {
       // press A button and wait for the timer change state
       ESP_LOGD(TAG, "Waiting for TIMER_CHANGE state to set timer to %d minutes", duration);
       timer_target_duration_ = duration; // this will instruct the start the logic of changing the duration once in TIMER_CHANGE state
-      this->timer_button_->press(); // this will enter the TIMER_CHANGE state
+      this->press_keys(KEY_TIMER, TX_PRIORITY_TIMER); // this will enter the TIMER_CHANGE state
       break;
     case DC_STATE_MEMORY:
     case DC_STATE_HEIGHT:
@@ -316,17 +1255,36 @@ void LoctekMotionComponent::set_timer_duration(uint8_t duration) {
       {
         timer_target_duration_ = duration; // in case we changed the duration again before it reached the old target
         auto current_duration = state_machine.timer_duration();
+        int8_t direction = duration > current_duration ? 1 : (duration < current_duration ? -1 : 0);
+        if (this->timer_fast_set_ && abs(duration - current_duration) > TIMER_HOLD_MARGIN) {
+          // far from the target: keep the key held (in the loop()) and let the controller repeat it
+          if (this->timer_hold_direction_ != direction) {
+            ESP_LOGD(TAG, "Timer is %d (target: %d), holding %s", current_duration, duration, direction > 0 ? "up" : "down");
+            this->timer_hold_direction_ = direction;
+            this->timer_hold_press_time_ = millis() - TIMER_HOLD_PRESS_INTERVAL_MS;
+            this->timer_hold_change_time_ = millis();
+          }
+          break;
+        }
+        if (this->timer_hold_direction_ != 0) {
+          // close to the target: release and correct one press per display change.
+          // the controller may still repeat the key for a moment, so wait for the display
+          this->timer_hold_direction_ = 0;
+          ESP_LOGD(TAG, "Timer is %d (target: %d), released", current_duration, duration);
+          this->timer_step_time_ = millis() + TIMER_STEP_INTERVAL_MS;
+          break;
+        }
         if (duration > current_duration) {
           ESP_LOGD(TAG, "Timer is %d (target: %d)", current_duration, duration);
-          this->up_button_->press();
+          this->press_keys(KEY_UP, TX_PRIORITY_TIMER);
         } else if (duration < current_duration) {
           ESP_LOGD(TAG, "Timer is %d (target: %d)", current_duration, duration);
-          this->down_button_->press();
+          this->press_keys(KEY_DOWN, TX_PRIORITY_TIMER);
         } else {
           // correct duration is already set
           timer_target_duration_ = 0;
-          ESP_LOGI(TAG, "Timer was set to %d minutes", duration);
-          this->timer_button_->press(); // start timer
+          ESP_LOGI(TAG, "Timer was set to %d minutes in %" PRIu32 " ms", duration, millis() - this->timer_set_start_time_);
+          this->press_keys(KEY_TIMER, TX_PRIORITY_TIMER); // start timer
           return;
         }
       }
@@ -335,6 +1293,40 @@ void LoctekMotionComponent::set_timer_duration(uint8_t duration) {
       break;
   }
 }
+#endif
 
 }  // namespace loctekmotion_desk
 }  // namespace esphome
+
+#ifdef USE_LOCTEKMOTION_DESK_ALLOCATION_COUNTER
+// all replaceable forms, so every allocation is counted and every delete frees what malloc returned.
+// the aligned forms are left to the library, they allocate and free on their own
+static void *counted_malloc(size_t size) {
+  esphome::loctekmotion_desk::heap_allocations++;
+  return malloc(size == 0 ? 1 : size);
+}
+
+static void *counted_malloc_or_fail(size_t size) {
+  void *ptr = counted_malloc(size);
+  if (ptr == nullptr) {
+#if __cpp_exceptions
+    throw std::bad_alloc();
+#else
+    abort();
+#endif
+  }
+  return ptr;
+}
+
+void *operator new(size_t size) { return counted_malloc_or_fail(size); }
+void *operator new[](size_t size) { return counted_malloc_or_fail(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return counted_malloc(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return counted_malloc(size); }
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { free(ptr); }
+#endif
@@ -1,15 +1,69 @@
 #pragma once
 
+#include "flight_recorder.h"
+#include "frame_dispatch.h"
+#include "key_frame.h"
+#include "ring_buffer.h"
 #include "state_machine.h"
+#include "tx_queue.h"
+#include "usage_statistics.h"
 #include "esphome/core/component.h"
+#include "esphome/core/defines.h"
 #include "esphome/components/binary_sensor/binary_sensor.h"
 #include "esphome/components/button/button.h"
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/components/text_sensor/text_sensor.h"
 #include "esphome/components/uart/uart.h"
 #include "esphome/core/helpers.h"
+#include "esphome/core/preferences.h"
 namespace esphome {
 namespace loctekmotion_desk {
+
+const size_t RX_BUFFER_SIZE = 64; // bytes drained from UART per read
+const size_t TX_QUEUE_SIZE = 8;   // key frames waiting to be sent
+const size_t FRAME_HANDLER_SLOTS = 8; // frame types with a handler, including the built-in ones
+
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+/**
+ * Link and loop() counters, aggregated between diagnostics updates
+ */
+struct DeskDiagnostics {
+  uint32_t frames;
+  uint32_t repeat_frames;   // exact repeats of the display that were not decoded
+  uint32_t unknown_frames;  // total
+  uint32_t unhandled_frames;  // total, frames of types without a handler
+  uint32_t transitions;
+  uint32_t loop_passes;     // passes that were not idle
+  uint32_t loop_time_us;
+  uint32_t loop_time_max_us;
+};
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+const uint8_t PRESET_COUNT = 3;
+
+/**
+ * Learned heights of the presets, persisted. 0 = not learned yet
+ */
+struct PresetHeights {
+  float heights[PRESET_COUNT];
+};
+
+enum PresetLearning : uint8_t {
+  PRESET_LEARNING_IDLE = 0,
+  PRESET_LEARNING_MOVE = 1,  // preset pressed, the height is learned when the desk stops
+  PRESET_LEARNING_SAVE = 2,  // preset pressed in memory mode, the height is learned once it's saved
+};
+#endif
+
+const float MOVE_DEFAULT_STOP_LATENCY = 0.25; // s, until learned from actual moves
+
+enum MoveToHeightPhase : uint8_t {
+  MOVE_IDLE = 0,
+  MOVE_PRESSING = 1,  // holding up/down until the predicted stopping point reaches the target
+  MOVE_SETTLING = 2,  // released, waiting for the desk to stop
+};
+
 class LoctekMotionComponent : public Component, public uart::UARTDevice {
  public:
   LoctekMotionComponent(uart::UARTComponent *uart);
@@ -26,94 +80,337 @@ class LoctekMotionComponent : public Component, public uart::UARTDevice {
     timer_active_binary_sensor_ = timer_active_binary_sensor;
   }
 
+#ifdef USE_LOCTEKMOTION_DESK_CONTROL_STATUS
   void set_control_status_text_sensor(text_sensor::TextSensor *control_status_text_sensor) {
     control_status_text_sensor_ = control_status_text_sensor;
   }
+#endif
 
-  void set_up_button(button::Button *up_button) {
-    up_button_ = up_button;
+  void set_height_sensor(sensor::Sensor *height_sensor) {
+    height_sensor_ = height_sensor;
   }
 
-  void set_down_button(button::Button *down_button) {
-    down_button_ = down_button;
+  void set_height_publish_interval(uint32_t height_publish_interval) {
+    height_publish_interval_ = height_publish_interval;
   }
 
-  void set_preset1_button(button::Button *preset1_button) {
-    preset1_button_ = preset1_button;
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+  void set_preset_height_sensor(uint8_t preset, sensor::Sensor *preset_height_sensor) {
+    preset_height_sensors_[preset - 1] = preset_height_sensor;
   }
+#endif
 
-  void set_preset2_button(button::Button *preset2_button) {
-    preset2_button_ = preset2_button;
-  }
+  void set_preferences_hash(uint32_t preferences_hash) { preferences_hash_ = preferences_hash; }
 
-  void set_preset3_button(button::Button *preset3_button) {
-    preset3_button_ = preset3_button;
-  }
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+  void set_standing_height(float standing_height) { standing_height_ = standing_height; }
+  void set_usage_publish_interval(uint32_t interval) { usage_publish_interval_ = interval; }
+  void set_usage_save_interval(uint32_t interval) { usage_save_interval_ = interval; }
+  void set_sitting_time_sensor(sensor::Sensor *sitting_time_sensor) { sitting_time_sensor_ = sitting_time_sensor; }
+  void set_standing_time_sensor(sensor::Sensor *standing_time_sensor) { standing_time_sensor_ = standing_time_sensor; }
+  void set_posture_changes_sensor(sensor::Sensor *posture_changes_sensor) { posture_changes_sensor_ = posture_changes_sensor; }
+  void set_motor_up_time_sensor(sensor::Sensor *motor_up_time_sensor) { motor_up_time_sensor_ = motor_up_time_sensor; }
+  void set_motor_down_time_sensor(sensor::Sensor *motor_down_time_sensor) { motor_down_time_sensor_ = motor_down_time_sensor; }
+  void set_timer_completions_sensor(sensor::Sensor *timer_completions_sensor) { timer_completions_sensor_ = timer_completions_sensor; }
+#endif
 
-  void set_memory_button(button::Button *memory_button) {
-    memory_button_ = memory_button;
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SENSOR
+  void set_timer_sensor(sensor::Sensor *timer_sensor) {
+    timer_sensor_ = timer_sensor;
   }
+#endif
 
-  void set_timer_button(button::Button *timer_button) {
-    timer_button_ = timer_button;
+#ifdef USE_LOCTEKMOTION_DESK_MOTION_SENSORS
+  void set_velocity_sensor(sensor::Sensor *velocity_sensor) {
+    velocity_sensor_ = velocity_sensor;
   }
 
-  void set_height_sensor(sensor::Sensor *height_sensor) {
-    height_sensor_ = height_sensor;
+  void set_eta_sensor(sensor::Sensor *eta_sensor) {
+    eta_sensor_ = eta_sensor;
   }
 
-  void set_timer_sensor(sensor::Sensor *timer_sensor) {
-    timer_sensor_ = timer_sensor;
+  void set_direction_text_sensor(text_sensor::TextSensor *direction_text_sensor) {
+    direction_text_sensor_ = direction_text_sensor;
   }
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_FLIGHT_RECORDER
+  void set_flight_recorder_size(size_t size) { flight_recorder_size_ = size; }
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_TRANSITION_TRACE
+  void set_transition_trace_size(size_t size) { transition_trace_size_ = size; }
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+  void set_diagnostics_interval(uint32_t interval) { diagnostics_interval_ = interval; }
+  void set_frame_rate_sensor(sensor::Sensor *frame_rate_sensor) { frame_rate_sensor_ = frame_rate_sensor; }
+  void set_crc_errors_sensor(sensor::Sensor *crc_errors_sensor) { crc_errors_sensor_ = crc_errors_sensor; }
+  void set_framing_errors_sensor(sensor::Sensor *framing_errors_sensor) { framing_errors_sensor_ = framing_errors_sensor; }
+  void set_dropped_bytes_sensor(sensor::Sensor *dropped_bytes_sensor) { dropped_bytes_sensor_ = dropped_bytes_sensor; }
+  void set_unknown_frames_sensor(sensor::Sensor *unknown_frames_sensor) { unknown_frames_sensor_ = unknown_frames_sensor; }
+  void set_unhandled_frames_sensor(sensor::Sensor *unhandled_frames_sensor) { unhandled_frames_sensor_ = unhandled_frames_sensor; }
+  void set_repeat_frames_sensor(sensor::Sensor *repeat_frames_sensor) { repeat_frames_sensor_ = repeat_frames_sensor; }
+  void set_transition_rate_sensor(sensor::Sensor *transition_rate_sensor) { transition_rate_sensor_ = transition_rate_sensor; }
+  void set_loop_time_max_sensor(sensor::Sensor *loop_time_max_sensor) { loop_time_max_sensor_ = loop_time_max_sensor; }
+  void set_loop_time_avg_sensor(sensor::Sensor *loop_time_avg_sensor) { loop_time_avg_sensor_ = loop_time_avg_sensor; }
+#endif
+  void dump_flight_recorder() const;
+  void dump_transition_trace() const;
 
   void add_on_timer_done_callback(std::function<void()> &&callback) { this->timer_done_callback_.add(std::move(callback)); }
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
   void set_timer_duration(uint8_t duration);
+#endif
+  void set_timer_fast_set(bool timer_fast_set) { timer_fast_set_ = timer_fast_set; }
+
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+  void add_on_move_to_height_done_callback(std::function<void(float)> &&callback) { this->move_to_height_done_callback_.add(std::move(callback)); }
+  void move_to_height(float height);
+#endif
+  void stop();
+
+  void send_frame(const uint8_t *data, size_t length, TxPriority priority);
+  void press_keys(uint8_t keys, TxPriority priority);
+
+  /**
+   * Registers a decoder for a frame type. Replaces the component's default handling of the beep (0x14) and
+   * of 0x11/0x15, but not the display decoding. Logs a warning and returns false if the type already has a
+   * handler or there are no free slots.
+   */
+  bool add_frame_handler(uint8_t type, FrameHandler &&handler);
 
   DeskControlState current_state() {
     return state_machine.current_state();
   }
 
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+  /**
+   * Gets the learned height of preset 1-3, or NAN if it's not known yet
+   */
+  float get_preset_height(uint8_t preset) const;
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+  /**
+   * Gets the usage totals, with the time of the current posture credited up to the last publish
+   */
+  const UsageTotals &get_usage_totals() const { return usage_statistics_.totals(); }
+#endif
+
   void dump_config() override;
 
   void setup() override;
   void loop() override;
+  void on_shutdown() override;
 
  protected:
 
   binary_sensor::BinarySensor *connected_binary_sensor_{nullptr};
   binary_sensor::BinarySensor *moving_binary_sensor_{nullptr};
   binary_sensor::BinarySensor *timer_active_binary_sensor_{nullptr};
-  button::Button *up_button_{nullptr};
-  button::Button *down_button_{nullptr};
-  button::Button *preset1_button_{nullptr};
-  button::Button *preset2_button_{nullptr};
-  button::Button *preset3_button_{nullptr};
-  button::Button *memory_button_{nullptr};
-  button::Button *timer_button_{nullptr};
-  text_sensor::TextSensor *control_status_text_sensor_{nullptr};
   sensor::Sensor *height_sensor_{nullptr};
-  sensor::Sensor *timer_sensor_{nullptr};  
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+  sensor::Sensor *preset_height_sensors_[PRESET_COUNT]{};
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_CONTROL_STATUS
+  text_sensor::TextSensor *control_status_text_sensor_{nullptr};
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SENSOR
+  sensor::Sensor *timer_sensor_{nullptr};
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_MOTION_SENSORS
+  sensor::Sensor *velocity_sensor_{nullptr};
+  sensor::Sensor *eta_sensor_{nullptr};
+  text_sensor::TextSensor *direction_text_sensor_{nullptr};
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+  sensor::Sensor *frame_rate_sensor_{nullptr};
+  sensor::Sensor *crc_errors_sensor_{nullptr};
+  sensor::Sensor *framing_errors_sensor_{nullptr};
+  sensor::Sensor *dropped_bytes_sensor_{nullptr};
+  sensor::Sensor *unknown_frames_sensor_{nullptr};
+  sensor::Sensor *unhandled_frames_sensor_{nullptr};
+  sensor::Sensor *repeat_frames_sensor_{nullptr};
+  sensor::Sensor *transition_rate_sensor_{nullptr};
+  sensor::Sensor *loop_time_max_sensor_{nullptr};
+  sensor::Sensor *loop_time_avg_sensor_{nullptr};
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+  sensor::Sensor *sitting_time_sensor_{nullptr};
+  sensor::Sensor *standing_time_sensor_{nullptr};
+  sensor::Sensor *posture_changes_sensor_{nullptr};
+  sensor::Sensor *motor_up_time_sensor_{nullptr};
+  sensor::Sensor *motor_down_time_sensor_{nullptr};
+  sensor::Sensor *timer_completions_sensor_{nullptr};
+#endif
 
   CallbackManager<void()> timer_done_callback_{};
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+  CallbackManager<void(float)> move_to_height_done_callback_{};
+#endif
 
  private:
+  bool has_pending_work_() const;
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+  bool has_diagnostics_sensors_() const;
+  void publish_diagnostics_();
+#endif
+  void scan_frames_();
+  void handle_frame_(const DataFrame &frame);
+  bool is_display_retrigger_due_() const;
+  void handle_display_frame_(const DataFrame &frame);
+  void handle_unhandled_frame_(const DataFrame &frame);
+
+  void process_tx_queue_();
+
   void update_connected_binary_sensor_();
+  bool is_moving_() const;
+  void update_height_sensor_();
   void update_moving_binary_sensor_();
+#ifdef USE_LOCTEKMOTION_DESK_CONTROL_STATUS
   void update_control_status_text_sensor_();
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_MOTION_SENSORS
+  void update_motion_sensors_();
+  float motion_target_height_() const;
+#endif
 
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
+  void update_timer_hold_();
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SENSOR
+  void schedule_timer_ticks_();
+  void anchor_calculated_timer_duration_(uint32_t remaining_seconds);
   void start_calculated_timer_duration_();
+  void sync_calculated_timer_duration_(bool minute_changed);
+  uint32_t calculated_timer_remaining_() const;
   void update_calculated_timer_duration_();
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+  bool has_preset_height_sensors_() const;
+  void setup_preset_heights_();
+  void observe_key_press_(uint8_t keys);
+  void start_preset_learning_(PresetLearning learning);
+  void update_preset_learning_(DeskControlState previous_state);
+  void learn_preset_height_(uint8_t index, float height);
+  void save_preset_heights_();
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+  bool has_usage_sensors_() const;
+  void setup_usage_statistics_();
+  void update_usage_motor_time_(float height, uint32_t now);
+  void update_usage_posture_();
+  void publish_usage_statistics_();
+  void save_usage_statistics_();
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_VELOCITY
+  void update_height_velocity_(float height, uint32_t now);
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+  void update_move_to_height_();
+  bool should_stop_moving_to_height_() const;
+  void finish_move_to_height_();
+#endif
+
+  uint32_t last_packet_time_{0};
+  bool is_timer_active_{false};
+  bool timer_fast_set_{true}; // hold up/down while far from the target timer duration
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SET
+  uint32_t timer_target_duration_{0}; // remember the target timer duration while setting it. 0 = not setting
+  uint32_t timer_step_time_{0}; // when to press the button again while setting the timer. 0 = not waiting
+  int8_t timer_hold_direction_{0}; // 1 = holding up, -1 = holding down, 0 = stepping one press per display change
+  uint32_t timer_hold_press_time_{0};
+  uint32_t timer_hold_change_time_{0}; // last time the duration changed while holding
+  uint32_t timer_set_start_time_{0};
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_TIMER_SENSOR
+  uint32_t timer_start_time_{0}; // when the countdown was last anchored to the display
+  uint32_t timer_total_seconds_{0}; // seconds remaining at timer_start_time_
+#endif
+  uint32_t desk_control_trigger_timestamps[SD_STATE_COUNT] = {0};
+
+  uint32_t height_publish_interval_{0}; // minimum time between height updates while moving (ms)
+  uint32_t height_publish_time_{0};
+  bool height_published_while_moving_{false};
+
+#ifdef USE_LOCTEKMOTION_DESK_VELOCITY
+  float height_velocity_{0}; // cm/s, positive when moving up
+  float last_height_{0};
+  uint32_t last_height_change_time_{0};
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_MOTION_SENSORS
+  uint32_t motion_publish_time_{0};
+  bool motion_published_{false}; // motion sensors have been published since the desk started moving
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_MOVE_TO_HEIGHT
+  MoveToHeightPhase move_phase_{MOVE_IDLE};
+  float move_target_height_{0};
+  int8_t move_direction_{0}; // 1 = up, -1 = down
+  uint8_t move_attempts_{0};
+  uint32_t move_phase_start_time_{0};
+  uint32_t move_last_press_time_{0};
+  float move_stop_height_{0}; // height and velocity when the key was released, to learn the stop latency
+  float move_stop_velocity_{0};
+  float move_stop_latency_{MOVE_DEFAULT_STOP_LATENCY}; // learned time from releasing the key until the desk stops (s)
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+  bool diagnostics_enabled_{false}; // this desk has diagnostics sensors
+  uint32_t diagnostics_interval_{60000};
+  uint32_t diagnostics_time_{0}; // start of the current aggregation period
+  DeskDiagnostics diagnostics_{};
+#endif
+
+  uint32_t preferences_hash_{0}; // from the desk id, tells the preferences of several desks apart
+
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+  bool preset_heights_enabled_{false}; // this desk has preset height sensors
+  PresetHeights preset_heights_{};
+  ESPPreferenceObject preset_heights_pref_;
+  bool preset_heights_save_pending_{false};
+  PresetLearning preset_learning_{PRESET_LEARNING_IDLE};
+  uint8_t preset_learning_index_{0};
+  bool preset_learning_moved_{false}; // the desk started moving after the preset was pressed
+  uint32_t preset_learning_time_{0};  // last preset press
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+  bool usage_statistics_enabled_{false}; // this desk has usage sensors
+  float standing_height_{95}; // cm, the desk is in standing position at or above this height
+  uint32_t usage_publish_interval_{60000};
+  uint32_t usage_save_interval_{3600000};
+  UsageStatistics usage_statistics_;
+  ESPPreferenceObject usage_statistics_pref_;
+  float usage_last_height_{0};
+  uint32_t usage_last_height_time_{0};
+#endif
+
+#ifdef USE_LOCTEKMOTION_DESK_FLIGHT_RECORDER
+  size_t flight_recorder_size_{0};
+  FlightRecorder flight_recorder_;
+#endif
 
-  uint32_t last_packet_time_;
-  uint32_t timer_target_duration_; // remember the target timer duration while setting it. 0 = not setting
-  uint32_t timer_start_time_; // store time of timer start to calculate elapsed time
-  uint32_t timer_total_seconds_; // store total timer duration at the start of the timer to calculate elapsed time
-  bool is_timer_active_;
-  uint32_t desk_control_trigger_timestamps[SD_STATE_TIMER_OFF+1] = {0};
+#ifdef USE_LOCTEKMOTION_DESK_TRANSITION_TRACE
+  size_t transition_trace_size_{0};
+#endif
 
+  RingBuffer<RX_BUFFER_SIZE> rx_buffer_;
+  TxQueue<TX_QUEUE_SIZE> tx_queue_;
+  uint32_t next_tx_time_{0};
   DataFrameReader data_reader;
+  FrameDispatcher<FRAME_HANDLER_SLOTS> frame_handlers_;
+  FrameTypeSet logged_frame_types_; // unhandled types are logged once
   SegmentDisplay display;
-  SegmentDisplayState last_display_state;
+  DecodedDisplay decoded_display{};
+  SegmentDisplayState last_display_state{SD_STATE_UNKNOWN};
   DeskStateMachine state_machine;
 };
 
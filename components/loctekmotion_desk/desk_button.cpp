@@ -0,0 +1,12 @@
+#include "desk_button.h"
+#include "desk.h"
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+void LoctekMotionButton::press_action() {
+  this->parent_->press_keys(this->keys_, this->priority_);
+}
+
+}  // namespace loctekmotion_desk
+}  // namespace esphome
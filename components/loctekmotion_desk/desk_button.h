@@ -0,0 +1,33 @@
+#pragma once
+
+#include "key_frame.h"
+#include "tx_queue.h"
+#include "esphome/core/helpers.h"
+#include "esphome/components/button/button.h"
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+class LoctekMotionComponent;
+
+/**
+ * Control panel key, or keys pressed together. Pressing it queues the key frame to be sent by the desk component,
+ * instead of writing to the UART directly, so frames from different automations don't interleave.
+ */
+class LoctekMotionButton : public button::Button, public Parented<LoctekMotionComponent> {
+ public:
+  void set_keys(uint8_t keys) { this->keys_ = keys; }
+  uint8_t get_keys() const { return this->keys_; }
+
+  void set_priority(TxPriority priority) { this->priority_ = priority; }
+  TxPriority get_priority() const { return this->priority_; }
+
+ protected:
+  void press_action() override;
+
+  uint8_t keys_{KEY_NONE};
+  TxPriority priority_{TX_PRIORITY_MOTION};
+};
+
+}  // namespace loctekmotion_desk
+}  // namespace esphome
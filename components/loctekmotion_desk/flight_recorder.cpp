@@ -0,0 +1,109 @@
+#include "flight_recorder.h"
+#include "esphome/core/log.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+static const char *const TAG = "loctekmotion_desk.flight_recorder";
+
+static const uint8_t DUMP_BYTES_PER_LINE = 32;
+
+void FlightRecorder::init(size_t capacity) {
+  if (capacity == 0)
+    return;
+  this->buffer_ = new uint8_t[capacity];
+  this->capacity_ = capacity;
+}
+
+void FlightRecorder::record(uint32_t now, const DataFrame &frame) {
+  if (this->buffer_ == nullptr)
+    return;
+
+  const uint8_t *data = &frame.raw[DATA_LENGTH_INDEX];
+  const uint8_t length = frame.data_length;
+  bool repeat = length == this->last_frame_length_ && memcmp(data, this->last_frame_, length) == 0;
+
+  uint32_t delta = this->size_ > 0 ? now - this->last_record_time_ : 0;
+  uint8_t varint[5];
+  uint8_t varint_length = 0;
+  // the shift drops the top bit of very long gaps, which is fine for a flight recorder
+  uint32_t value = (delta << 1) | (repeat ? 1 : 0);
+  do {
+    varint[varint_length] = value & 0x7F;
+    value >>= 7;
+    if (value > 0)
+      varint[varint_length] |= 0x80;
+    varint_length++;
+  } while (value > 0);
+
+  size_t record_size = varint_length + (repeat ? 0 : length);
+  if (record_size > this->capacity_)
+    return;
+  while (this->capacity_ - this->size_ < record_size)
+    this->drop_oldest_();
+
+  for (uint8_t i = 0; i < varint_length; i++)
+    this->push_(varint[i]);
+  if (!repeat) {
+    for (uint8_t i = 0; i < length; i++)
+      this->push_(data[i]);
+    memcpy(this->last_frame_, data, length);
+    this->last_frame_length_ = length;
+  }
+  this->last_record_time_ = now;
+}
+
+void FlightRecorder::push_(uint8_t byte) {
+  this->buffer_[(this->tail_ + this->size_) % this->capacity_] = byte;
+  this->size_++;
+}
+
+void FlightRecorder::drop_oldest_() {
+  // oldest record may now be a repeat of a dropped frame; replay skips repeats until it sees a full frame
+  size_t offset = 0;
+  bool repeat = (this->at_(0) & 1) != 0;
+  while (this->at_(offset) & 0x80)
+    offset++;
+  offset++;
+  if (!repeat)
+    offset += this->at_(offset);  // length byte counts itself
+
+  this->tail_ = (this->tail_ + offset) % this->capacity_;
+  this->size_ -= offset;
+  this->dropped_records_++;
+}
+
+void FlightRecorder::dump() const {
+  if (this->buffer_ == nullptr) {
+    ESP_LOGW(TAG, "Flight recorder is not enabled");
+    return;
+  }
+
+  ESP_LOGI(TAG, "FR BEGIN %u bytes, %" PRIu32 " records dropped", (unsigned) this->size_, this->dropped_records_);
+
+  char line[DUMP_BYTES_PER_LINE * 2 + 1];
+  size_t pos = 0;
+  for (uint8_t byte : FLIGHT_RECORDER_MAGIC)
+    pos += snprintf(&line[pos], sizeof(line) - pos, "%02X", byte);
+  pos += snprintf(&line[pos], sizeof(line) - pos, "%02X", FLIGHT_RECORDER_VERSION);
+
+  for (size_t offset = 0; offset < this->size_; offset++) {
+    pos += snprintf(&line[pos], sizeof(line) - pos, "%02X", this->at_(offset));
+    if (pos == DUMP_BYTES_PER_LINE * 2) {
+      ESP_LOGI(TAG, "FR:%s", line);
+      pos = 0;
+    }
+  }
+  if (pos > 0) {
+    ESP_LOGI(TAG, "FR:%s", line);
+  }
+
+  ESP_LOGI(TAG, "FR END");
+}
+
+} // namespace loctekmotion_desk
+} // namespace esphome
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "segment_display.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+/* Capture format (all frames are stored without start and end bytes):
+
+  header:  'L' 'M' 'F' 'R' <version>
+  record:  varint(delta_ms << 1 | repeat) [frame bytes from the length byte up to the CRC]
+
+  delta_ms is the time since the previous record (0 for the first one).
+  repeat = 1 means the frame is identical to the previous record's frame and its bytes are omitted.
+  varint is 7 bits per byte, least significant first, high bit set when more bytes follow.
+*/
+const uint8_t FLIGHT_RECORDER_MAGIC[] = {'L', 'M', 'F', 'R'};
+const uint8_t FLIGHT_RECORDER_VERSION = 1;
+
+/**
+ * Keeps the most recent received frames in a fixed size RAM ring buffer,
+ * dropping the oldest records when full.
+ */
+class FlightRecorder {
+ public:
+  /**
+   * Allocates the buffer. Called once from setup(). A capacity of 0 leaves the recorder disabled.
+   */
+  void init(size_t capacity);
+
+  void record(uint32_t now, const DataFrame &frame);
+
+  /**
+   * Logs the capture as hex lines, to be extracted by tools/replay_capture.py
+   */
+  void dump() const;
+
+  size_t size() const { return this->size_; }
+  size_t capacity() const { return this->capacity_; }
+  uint32_t dropped_records() const { return this->dropped_records_; }
+
+ protected:
+  void push_(uint8_t byte);
+  uint8_t at_(size_t offset) const { return this->buffer_[(this->tail_ + offset) % this->capacity_]; }
+  void drop_oldest_();
+
+  uint8_t *buffer_{nullptr};
+  size_t capacity_{0};
+  size_t tail_{0};  // oldest byte
+  size_t size_{0};
+  uint32_t last_record_time_{0};
+  uint32_t dropped_records_{0};
+  uint8_t last_frame_[DATA_FRAME_MAX_SIZE]{};
+  uint8_t last_frame_length_{0};
+};
+
+} // namespace loctekmotion_desk
+} // namespace esphome
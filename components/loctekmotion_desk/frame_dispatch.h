@@ -0,0 +1,132 @@
+#pragma once
+
+#include "segment_display.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+using FrameHandler = std::function<void(const DataFrame &)>;
+
+const uint8_t FRAME_PAYLOAD_MAX_SIZE = DATA_FRAME_MAX_SIZE - 2 - DATA_FRAME_OVERHEAD;  // without start and end bytes
+
+/**
+ * Payload of a received frame, without the length, type and CRC bytes. Small enough to pass by value, so
+ * automations get their own copy without a heap allocation per frame.
+ */
+struct FramePayload {
+  uint8_t bytes[FRAME_PAYLOAD_MAX_SIZE];
+  uint8_t length;
+
+  explicit FramePayload(const DataFrame &frame) {
+    length = frame.data_length > DATA_FRAME_OVERHEAD ? frame.data_length - DATA_FRAME_OVERHEAD : 0;
+    if (length > FRAME_PAYLOAD_MAX_SIZE)
+      length = FRAME_PAYLOAD_MAX_SIZE;
+    memcpy(bytes, frame.data, length);
+  }
+
+  size_t size() const { return length; }
+  const uint8_t *data() const { return bytes; }
+  uint8_t operator[](size_t index) const { return bytes[index]; }
+  const uint8_t *begin() const { return bytes; }
+  const uint8_t *end() const { return bytes + length; }
+};
+
+/**
+ * Frame handlers by frame type. Types hash into N slots by their low bits, colliding ones take the
+ * next free slot, so a lookup is a single probe unless two registered types share their low bits.
+ * Handlers are registered during setup and never removed, but a default handler is replaced by the
+ * first handler added for its type.
+ */
+template<size_t N> class FrameDispatcher {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "FrameDispatcher size must be a power of two");
+
+ public:
+  /**
+   * Registers the handler of a frame type, replacing its default handler if it has one. Returns false if
+   * the type already has a handler that is not a default, or all slots are taken.
+   */
+  bool add(uint8_t type, FrameHandler &&handler) { return this->add_(type, std::move(handler), false); }
+
+  /**
+   * Registers a handler to use until another one is added for the type. nullptr marks the type as known
+   * without handling it.
+   */
+  bool add_default(uint8_t type, FrameHandler &&handler) { return this->add_(type, std::move(handler), true); }
+
+  /**
+   * Calls the handler of the frame's type. Returns false if there is none.
+   */
+  bool dispatch(const DataFrame &frame) const {
+    for (size_t probe = 0; probe < N; probe++) {
+      const Slot &slot = slots_[(frame.type + probe) & (N - 1)];
+      if (!slot.used)
+        return false;  // types are never removed, so the probe sequence ends at the first free slot
+      if (slot.type == frame.type) {
+        if (slot.handler)
+          slot.handler(frame);
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  struct Slot {
+    uint8_t type{0};
+    bool used{false};
+    bool is_default{false};
+    FrameHandler handler;
+  };
+
+  bool add_(uint8_t type, FrameHandler &&handler, bool is_default) {
+    for (size_t probe = 0; probe < N; probe++) {
+      Slot &slot = slots_[(type + probe) & (N - 1)];
+      if (slot.used && slot.type == type) {
+        if (!slot.is_default || is_default)
+          return false;
+        slot.is_default = false;
+        slot.handler = std::move(handler);
+        return true;
+      }
+      if (!slot.used) {
+        slot.type = type;
+        slot.used = true;
+        slot.is_default = is_default;
+        slot.handler = std::move(handler);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  Slot slots_[N];
+};
+
+/**
+ * One bit per frame type, to log the first frame of each unhandled type only
+ */
+class FrameTypeSet {
+ public:
+  /**
+   * Adds the type. Returns true if it was not in the set yet.
+   */
+  bool insert(uint8_t type) {
+    uint8_t mask = 1 << (type & 7);
+    if (bits_[type >> 3] & mask)
+      return false;
+    bits_[type >> 3] |= mask;
+    return true;
+  }
+
+ private:
+  uint8_t bits_[32]{};
+};
+
+}  // namespace loctekmotion_desk
+}  // namespace esphome
@@ -0,0 +1,9 @@
+#include "key_frame.h"
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+constexpr KeyFrameCrcTable KEY_FRAME_CRC_TABLE PROGMEM = make_key_frame_crc_table();
+
+} // namespace loctekmotion_desk
+} // namespace esphome
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "segment_display.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+const uint8_t DATA_TYPE_KEYS        = 0x02;
+const uint8_t KEY_FRAME_SIZE        = 8;
+const uint8_t KEY_FRAME_LENGTH      = KEY_FRAME_SIZE - 2; // data_length excludes header and footer
+
+/**
+ * Control panel keys, as sent in the low byte of a key frame. Keys pressed together are or-ed.
+ */
+enum DeskKey : uint8_t {
+  KEY_NONE = 0x00,  // all keys released
+  KEY_UP = 0x01,
+  KEY_DOWN = 0x02,
+  KEY_PRESET1 = 0x04,
+  KEY_PRESET2 = 0x08,
+  KEY_PRESET3 = 0x10,
+  KEY_MEMORY = 0x20,  // "M"
+  KEY_TIMER = 0x40,   // "A"
+};
+
+const uint8_t KEY_MASK              = 0x7F;
+
+/**
+ * Modbus-CRC16 of one byte, bit by bit, for building tables at compile time
+ */
+constexpr uint16_t crc16_update_bitwise(uint16_t crc, uint8_t byte) {
+  crc ^= byte;
+  for (uint8_t i = 0; i < 8; i++) {
+    crc = (crc & 1) ? (crc >> 1) ^ CRC16_POLYNOMIAL : crc >> 1;
+  }
+  return crc;
+}
+
+/**
+ * CRC of the key frame for the keys (length, type and the two key bytes)
+ */
+constexpr uint16_t key_frame_crc(uint8_t keys) {
+  return crc16_update_bitwise(
+      crc16_update_bitwise(crc16_update_bitwise(crc16_update_bitwise(CRC16_INIT, KEY_FRAME_LENGTH), DATA_TYPE_KEYS),
+                           keys),
+      0x00);
+}
+
+struct KeyFrameCrcTable {
+  uint16_t values[KEY_MASK + 1];
+};
+
+/**
+ * Builds the CRC of every key combination at compile time
+ */
+constexpr KeyFrameCrcTable make_key_frame_crc_table() {
+  KeyFrameCrcTable table{};
+  for (uint16_t keys = 0; keys <= KEY_MASK; keys++) {
+    table.values[keys] = key_frame_crc(keys);
+  }
+  return table;
+}
+
+// the frames sent by the original control panel
+static_assert(key_frame_crc(KEY_NONE) == 0x6CA1, "Unexpected key frame CRC");
+static_assert(key_frame_crc(KEY_UP) == 0xFCA0, "Unexpected key frame CRC");
+static_assert(key_frame_crc(KEY_DOWN) == 0x0CA0, "Unexpected key frame CRC");
+static_assert(key_frame_crc(KEY_PRESET1) == 0xACA3, "Unexpected key frame CRC");
+static_assert(key_frame_crc(KEY_PRESET2) == 0xACA6, "Unexpected key frame CRC");
+static_assert(key_frame_crc(KEY_PRESET3) == 0xACAC, "Unexpected key frame CRC");
+static_assert(key_frame_crc(KEY_MEMORY) == 0xACB8, "Unexpected key frame CRC");
+static_assert(key_frame_crc(KEY_TIMER) == 0xAC90, "Unexpected key frame CRC");
+
+// defined in key_frame.cpp, lives in flash on ESP8266
+extern const KeyFrameCrcTable KEY_FRAME_CRC_TABLE;
+
+struct KeyFrame {
+  uint8_t raw[KEY_FRAME_SIZE];
+};
+
+/**
+ * Builds the frame pressing the keys (KEY_NONE releases all). The CRC is looked up, not calculated.
+ */
+inline KeyFrame encode_key_frame(uint8_t keys) {
+  keys &= KEY_MASK;
+  uint16_t crc = progmem_read_uint16(&KEY_FRAME_CRC_TABLE.values[keys]);
+  return KeyFrame{{DATA_FRAME_START, KEY_FRAME_LENGTH, DATA_TYPE_KEYS, keys, 0x00, (uint8_t) (crc >> 8),
+                   (uint8_t) (crc & 0xFF), DATA_FRAME_END}};
+}
+
+}  // namespace loctekmotion_desk
+}  // namespace esphome
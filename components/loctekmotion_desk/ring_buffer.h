@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+/**
+ * Fixed size single producer/single consumer byte queue.
+ * Size must be a power of 2 so that indexes can wrap with a mask.
+ */
+template<size_t N> class RingBuffer {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "RingBuffer size must be a power of 2");
+  static_assert(N <= 128, "RingBuffer indexes are 8 bit");
+
+ public:
+  size_t size() const { return (uint8_t) (head_ - tail_); }
+  size_t free() const { return N - size(); }
+  bool empty() const { return head_ == tail_; }
+
+  bool push(uint8_t byte) {
+    if (free() == 0)
+      return false;
+    buffer_[head_ & MASK] = byte;
+    head_++;
+    return true;
+  }
+
+  bool pop(uint8_t *byte) {
+    if (empty())
+      return false;
+    *byte = buffer_[tail_ & MASK];
+    tail_++;
+    return true;
+  }
+
+  /**
+   * Returns largest contiguous free region, to be filled directly (e.g. by a bulk UART read).
+   * Call commit() with the number of bytes actually written.
+   */
+  uint8_t *write_region(size_t *len) {
+    size_t offset = head_ & MASK;
+    size_t contiguous = N - offset;
+    *len = contiguous < free() ? contiguous : free();
+    return &buffer_[offset];
+  }
+
+  void commit(size_t len) { head_ += len; }
+
+  void clear() { head_ = tail_ = 0; }
+
+ protected:
+  static const size_t MASK = N - 1;
+
+  uint8_t buffer_[N];
+  uint8_t head_{0};  // free running write counter
+  uint8_t tail_{0};  // free running read counter
+};
+
+} // namespace loctekmotion_desk
+} // namespace esphome
@@ -0,0 +1,10 @@
+#include "segment_display.h"
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+constexpr Crc16Table CRC16_TABLE PROGMEM = make_crc16_table();
+constexpr SegmentDigitTable SEGMENT_DIGIT_TABLE PROGMEM = make_segment_digit_table();
+
+} // namespace loctekmotion_desk
+} // namespace esphome
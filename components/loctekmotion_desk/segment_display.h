@@ -1,8 +1,12 @@
 #pragma once
 
-#include "esphome/core/helpers.h"
+#include "esphome/core/hal.h"
 #include "esphome/core/log.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
 namespace esphome {
 namespace loctekmotion_desk {
 
@@ -13,6 +17,48 @@ const uint8_t DATA_MIN_SIZE         = 2;
 const uint8_t DATA_FRAME_START      = 0x9b;
 const uint8_t DATA_FRAME_END        = 0x9d;
 const uint8_t DATA_TYPE_DISPLAY     = 0x12;
+const uint8_t DATA_TYPE_BEEP        = 0x14; // 9B:04:14:7F:03:9D when the alarm beeped
+const uint8_t DATA_TYPE_UNKNOWN_11  = 0x11; // seen in normal traffic, payload not characterized yet
+const uint8_t DATA_TYPE_UNKNOWN_15  = 0x15; // seen in normal traffic, payload not characterized yet
+// 9B:04:81:10:C3:9D 15 seconds after the alarm beeped. also sometimes sent while the alarm timer is on
+// e.g 7 minutes after the alarm timer started. not handled yet
+const uint8_t DATA_FRAME_OVERHEAD   = 4; // length, type and CRC bytes counted in data_length
+
+const uint16_t CRC16_INIT           = 0xFFFF;
+const uint16_t CRC16_POLYNOMIAL     = 0xA001; // reversed 0x8005 (Modbus)
+
+struct Crc16Table {
+  uint16_t values[256];
+};
+
+/**
+ * Builds Modbus-CRC16 lookup table at compile time.
+ * Based on https://github.com/LacobusVentura/MODBUS-CRC16/blob/master/MODBUS_CRC16.c
+ */
+constexpr Crc16Table make_crc16_table() {
+  Crc16Table table{};
+  for (uint16_t index = 0; index < 256; index++) {
+    uint16_t crc = index;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc & 1) ? (crc >> 1) ^ CRC16_POLYNOMIAL : crc >> 1;
+    }
+    table.values[index] = crc;
+  }
+  return table;
+}
+
+static_assert(make_crc16_table().values[0x01] == 0xC0C1, "Unexpected Modbus-CRC16 table");
+static_assert(make_crc16_table().values[0xFF] == 0x4040, "Unexpected Modbus-CRC16 table");
+
+// defined in segment_display.cpp, lives in flash on ESP8266
+extern const Crc16Table CRC16_TABLE;
+
+/**
+ * Adds one byte to a running Modbus-CRC16 checksum.
+ */
+inline uint16_t crc16_update(uint16_t crc, uint8_t byte) {
+  return (crc >> 8) ^ progmem_read_uint16(&CRC16_TABLE.values[(crc ^ byte) & 0xFF]);
+}
 
 struct DataFrame {
   union {
@@ -64,27 +110,16 @@ struct DataFrame {
   }
 
   /**
-   * Calculates CRC on the current data by creating an XOR sum
+   * Calculates CRC on the current data (length, type and payload)
    */
   uint16_t calculate_crc() const {
     if (!validate_bounds())
       return 0;
 
-    // based on https://github.com/LacobusVentura/MODBUS-CRC16/blob/master/MODBUS_CRC16.c
-    uint16_t crc = 0xFFFF;
+    uint16_t crc = CRC16_INIT;
     uint8_t len = size() - 3; // exclude footer and crc
-    for (uint8_t pos = 1; pos < len; pos++)
-    {
-      crc ^= raw[pos];
-
-      for (uint16_t i = 0; i < 8; i++) {
-          if (crc & 1) {
-              crc >>= 1;
-              crc ^= 0xA001;
-          } else {
-              crc >>= 1;
-          }
-      }
+    for (uint8_t pos = 1; pos < len; pos++) {
+      crc = crc16_update(crc, raw[pos]);
     }
     return crc;
   }
@@ -94,16 +129,25 @@ struct DataFrame {
       raw[i] = 0;
     }
   }
-
-  std::vector<uint8_t> get_data() const { return std::vector<uint8_t>(raw, raw + size()); }
 };
 
 
+/**
+ * Error counters of the DataFrameReader, for diagnostics
+ */
+struct DataFrameReaderErrors {
+  uint32_t crc;           // frame with mismatched CRC
+  uint32_t framing;       // unexpected last byte
+  uint32_t length;        // length byte out of bounds
+  uint32_t dropped_bytes; // bytes discarded while looking for the start of a frame
+};
+
 struct DataFrameReader {
   DataFrame frame;
 
   bool crc_valid;
   bool complete;
+  bool repeat;  // the complete frame is byte for byte the last display frame
   uint8_t data_index_;
 
   void reset() {
@@ -111,38 +155,128 @@ struct DataFrameReader {
     crc_valid = false;
     data_index_ = 0;
     complete = false;
+    repeat = false;
+    reference_size_ = 0;
   }
 
+  /**
+   * Adds next received byte to the frame. CRC is accumulated as bytes arrive,
+   * so completing a frame only needs to compare it with the received one.
+   * The controller sends the same display frame over and over, so each byte is first compared with
+   * the last display frame, whose CRC was valid. A frame that matches it to the end is flagged as a
+   * repeat without a CRC, which is only caught up on the bytes so far at the first mismatch.
+   * The frame is kept until the next start byte, the caller doesn't need to reset the reader.
+   * On a length, framing or CRC error the bytes received after the bad frame's start
+   * are queued to be parsed again (see pop_pending()), so that a frame starting
+   * inside a corrupted one is not lost.
+   * Returns true when a complete frame with a valid CRC has been received.
+   */
   bool put(uint8_t byte) {
-    if (data_index_ == 0 && byte != DATA_FRAME_START)
-      return false;
+    if (data_index_ == 0) {
+      if (byte != DATA_FRAME_START) {
+        errors_.dropped_bytes++;
+        return false;
+      }
+      crc_ = CRC16_INIT;
+      frame_size_ = 0;
+      complete = false;
+      repeat = false;
+      matches_reference_ = reference_size_ > 0;
+    }
 
     frame.raw[data_index_] = byte;
-    if (data_index_ > DATA_LENGTH_INDEX && (data_index_ + 1) == frame.size()) {
+    if (matches_reference_ && reference_[data_index_] != byte) {
+      // the length byte is compared too, so the frame can't outgrow the reference
+      matches_reference_ = false;
+      for (uint8_t i = 1; i < data_index_ && i + 3 < frame_size_; i++)
+        crc_ = crc16_update(crc_, frame.raw[i]);
+    }
+    if (data_index_ == DATA_LENGTH_INDEX) {
+      frame_size_ = frame.size(); // 0 if length is out of bounds
+      if (frame_size_ == 0) {
+        errors_.length++;
+        ESP_LOGW("loctekmotion_desk.segment_display", "Unexpected data length: %d", byte);
+        resync_();
+        return false;
+      }
+    }
+
+    if (data_index_ > DATA_LENGTH_INDEX && (data_index_ + 1) == frame_size_) {
       // last byte
       if (byte != DATA_FRAME_END) {
+        errors_.framing++;
         ESP_LOGW("loctekmotion_desk.segment_display", "Unexpected last byte: 0x%02x", byte);
+        resync_();
         return false;
       }
-      // ESP_LOGD("loctekmotion_desk.segment_display", "Received CRC: 0x%04x, Calculated CRC: 0x%04x", frame.crc(), frame.calculate_crc());
-      crc_valid = frame.validate_crc();      
-      data_index_ = 0;  // prepare for next frame
-      complete = true;
+      // ESP_LOGD("loctekmotion_desk.segment_display", "Received CRC: 0x%04x, Calculated CRC: 0x%04x", frame.crc(), crc_);
+      crc_valid = matches_reference_ || crc_ == frame.crc();
       if (!crc_valid) {
+        errors_.crc++;
         ESP_LOGW("loctekmotion_desk.segment_display", "CRC not matched!");
+        resync_();
+        return false;
       }
-      return crc_valid;
-    } else {
-      data_index_++;
-      if (data_index_ == DATA_FRAME_MAX_SIZE) {
-        data_index_ = 0;
-        ESP_LOGW("loctekmotion_desk.segment_display", "Went over buffer");
+      repeat = matches_reference_;
+      if (!repeat && frame.type == DATA_TYPE_DISPLAY) {
+        // the controller repeats its display frames, the others are interleaved once in a while
+        memcpy(reference_, frame.raw, frame_size_);
+        reference_size_ = frame_size_;
       }
-      return false;
+      data_index_ = 0;  // prepare for next frame
+      complete = true;
+      return true;
     }
+
+    if (!matches_reference_ && data_index_ + 3 < frame_size_) {
+      // length, type or payload byte
+      crc_ = crc16_update(crc_, byte);
+    }
+    data_index_++;
+    return false;
   }
 
+  /**
+   * Gets next byte queued for re-parsing after an error. These must be put()
+   * before any newly received bytes.
+   */
+  bool pop_pending(uint8_t *byte) {
+    if (pending_count_ == 0)
+      return false;
+    *byte = pending_[--pending_count_];
+    return true;
+  }
+
+  const DataFrameReaderErrors &errors() const { return errors_; }
+
  private:
+  /**
+   * Drops the current frame start and queues the rest of the buffered bytes, from the next
+   * start marker onwards, to be parsed again.
+   */
+  void resync_() {
+    uint8_t count = data_index_ + 1;
+    uint8_t next_start = 1;
+    while (next_start < count && frame.raw[next_start] != DATA_FRAME_START)
+      next_start++;
+    errors_.dropped_bytes += next_start;
+
+    // pending bytes are a stack, so push in reverse to have them parsed before any still pending ones
+    for (uint8_t i = count; i > next_start; i--)
+      pending_[pending_count_++] = frame.raw[i - 1];
+
+    data_index_ = 0;
+  }
+
+  uint16_t crc_{CRC16_INIT};
+  uint8_t frame_size_{0};
+  // buffered plus pending bytes never exceed one frame, as new bytes are only put once pending ones are parsed
+  uint8_t pending_[DATA_FRAME_MAX_SIZE];
+  uint8_t pending_count_{0};
+  uint8_t reference_[DATA_FRAME_MAX_SIZE];  // last display frame with a valid CRC
+  uint8_t reference_size_{0};
+  bool matches_reference_{false};  // every byte of the current frame so far equals the reference
+  DataFrameReaderErrors errors_{};
 };
 
 /* Each segment is controled by the corresponding bit:
@@ -190,6 +324,8 @@ enum SegmentDisplayState : uint8_t {
   SD_STATE_TIMER_OFF = 8
 };
 
+const uint8_t SD_STATE_COUNT = SD_STATE_TIMER_OFF + 1;
+
 struct SegmentDisplay {
   struct {
     uint8_t segment1;
@@ -198,95 +334,127 @@ struct SegmentDisplay {
   };
 };
 
-inline uint8_t segment_to_digit(uint8_t s) {
-  uint8_t digit = s & SEGMENT_SYMBOL_MASK;
-
-  switch (digit) {
-    case SEGMENT_SYMBOL_0: return 0;
-    case SEGMENT_SYMBOL_1: return 1;
-    case SEGMENT_SYMBOL_2: return 2;
-    case SEGMENT_SYMBOL_3: return 3;
-    case SEGMENT_SYMBOL_4: return 4;
-    case SEGMENT_SYMBOL_5: return 5;
-    case SEGMENT_SYMBOL_6: return 6;
-    case SEGMENT_SYMBOL_7: return 7;
-    case SEGMENT_SYMBOL_8: return 8;
-    case SEGMENT_SYMBOL_9: return 9;
-    default:
-      return 255;
+const uint8_t SEGMENT_NOT_DIGIT     = 255;
+
+struct SegmentDigitTable {
+  uint8_t values[SEGMENT_SYMBOL_MASK + 1];
+};
+
+/**
+ * Builds segment symbol (without the dot) to digit lookup table at compile time.
+ * Symbols that are not digits map to SEGMENT_NOT_DIGIT.
+ */
+constexpr SegmentDigitTable make_segment_digit_table() {
+  SegmentDigitTable table{};
+  for (uint8_t symbol = 0; symbol <= SEGMENT_SYMBOL_MASK; symbol++) {
+    table.values[symbol] = SEGMENT_NOT_DIGIT;
   }
+  table.values[SEGMENT_SYMBOL_0] = 0;
+  table.values[SEGMENT_SYMBOL_1] = 1;
+  table.values[SEGMENT_SYMBOL_2] = 2;
+  table.values[SEGMENT_SYMBOL_3] = 3;
+  table.values[SEGMENT_SYMBOL_4] = 4;
+  table.values[SEGMENT_SYMBOL_5] = 5;
+  table.values[SEGMENT_SYMBOL_6] = 6;
+  table.values[SEGMENT_SYMBOL_7] = 7;
+  table.values[SEGMENT_SYMBOL_8] = 8;
+  table.values[SEGMENT_SYMBOL_9] = 9;
+  return table;
+}
+
+// defined in segment_display.cpp, lives in flash on ESP8266
+extern const SegmentDigitTable SEGMENT_DIGIT_TABLE;
+
+inline uint8_t segment_to_digit(uint8_t s) {
+  return progmem_read_byte(&SEGMENT_DIGIT_TABLE.values[s & SEGMENT_SYMBOL_MASK]);
 }
 
 inline bool is_decimal(uint8_t b) { return (b & SEGMENT_DOT_BIT) == SEGMENT_DOT_BIT; }
 
-inline const SegmentDisplayState get_display_state(const struct SegmentDisplay *display) {
-  if (display->segment1 == SEGMENT_OFF 
-      && display->segment2 == SEGMENT_OFF 
-      && display->segment3 == SEGMENT_OFF)
-    return SD_STATE_OFF;
-
-  if (display->segment1 == SEGMENT_SYMBOL_S 
-      && display->segment2 == SEGMENT_SYMBOL_DASH 
-      && display->segment3 == SEGMENT_OFF)
-    return SD_STATE_MEMORY;
-
-  if (display->segment1 == SEGMENT_OFF 
-      && display->segment2 == SEGMENT_SYMBOL_O 
-      && display->segment3 == SEGMENT_SYMBOL_N)
-    return SD_STATE_TIMER_ON;
-
-
-  if (display->segment1 == SEGMENT_SYMBOL_O 
-      && display->segment2 == SEGMENT_SYMBOL_F
-      && display->segment3 == SEGMENT_SYMBOL_F)
-    return SD_STATE_TIMER_OFF;
-
-  if (display->segment1 == SEGMENT_SYMBOL_COLON 
-      && display->segment2 == SEGMENT_OFF 
-      && display->segment3 == SEGMENT_OFF)
-    return SD_STATE_TIMER_DURATION_OFF;
-
-  if (display->segment1 == SEGMENT_SYMBOL_COLON 
-      && segment_to_digit(display->segment2) < 10
-      && segment_to_digit(display->segment3) < 10)
-    return SD_STATE_TIMER_DURATION_ON;
-
-  if (display->segment1 == SEGMENT_OFF 
-      && segment_to_digit(display->segment2) < 10
-      && segment_to_digit(display->segment3) < 10)
-    return SD_STATE_TIMER_DURATION_ONLY;
-
-  if (segment_to_digit(display->segment1) < 10
-      && segment_to_digit(display->segment2) < 10
-      && segment_to_digit(display->segment3) < 10)
-    return SD_STATE_HEIGHT;
-
-  return SD_STATE_UNKNOWN;
+/**
+ * Everything that can be read from one display frame
+ */
+struct DecodedDisplay {
+  SegmentDisplayState state;
+  float height;     // set if state is SD_STATE_HEIGHT
+  uint8_t minutes;  // set if state is SD_STATE_TIMER_DURATION_ON or SD_STATE_TIMER_DURATION_ONLY
+  bool dot;         // decimal dot is shown
+};
+
+/**
+ * Classifies the display and reads its value, looking up each segment only once
+ */
+inline DecodedDisplay decode_display(const struct SegmentDisplay *display) {
+  const uint8_t s1 = display->segment1;
+  const uint8_t s2 = display->segment2;
+  const uint8_t s3 = display->segment3;
+
+  DecodedDisplay decoded{SD_STATE_UNKNOWN, 0, 0, is_decimal(s2)};
+
+  if (s3 == SEGMENT_OFF) {
+    if (s1 == SEGMENT_OFF && s2 == SEGMENT_OFF) {
+      decoded.state = SD_STATE_OFF;
+      return decoded;
+    }
+    if (s1 == SEGMENT_SYMBOL_S && s2 == SEGMENT_SYMBOL_DASH) {
+      decoded.state = SD_STATE_MEMORY;
+      return decoded;
+    }
+    if (s1 == SEGMENT_SYMBOL_COLON && s2 == SEGMENT_OFF) {
+      decoded.state = SD_STATE_TIMER_DURATION_OFF;
+      return decoded;
+    }
+  }
+
+  if (s1 == SEGMENT_OFF && s2 == SEGMENT_SYMBOL_O && s3 == SEGMENT_SYMBOL_N) {
+    decoded.state = SD_STATE_TIMER_ON;
+    return decoded;
+  }
+
+  if (s1 == SEGMENT_SYMBOL_O && s2 == SEGMENT_SYMBOL_F && s3 == SEGMENT_SYMBOL_F) {
+    decoded.state = SD_STATE_TIMER_OFF;
+    return decoded;
+  }
+
+  const uint8_t d2 = segment_to_digit(s2);
+  const uint8_t d3 = segment_to_digit(s3);
+  if (d2 == SEGMENT_NOT_DIGIT || d3 == SEGMENT_NOT_DIGIT)
+    return decoded;
+
+  if (s1 == SEGMENT_SYMBOL_COLON || s1 == SEGMENT_OFF) {
+    decoded.state = s1 == SEGMENT_SYMBOL_COLON ? SD_STATE_TIMER_DURATION_ON : SD_STATE_TIMER_DURATION_ONLY;
+    decoded.minutes = d2 * 10 + d3;
+    return decoded;
+  }
+
+  const uint8_t d1 = segment_to_digit(s1);
+  if (d1 == SEGMENT_NOT_DIGIT)
+    return decoded;
+
+  decoded.state = SD_STATE_HEIGHT;
+  decoded.height = d1 * 100 + d2 * 10 + d3;
+  if (decoded.dot) {
+    decoded.height /= 10;
+  }
+  return decoded;
+}
+
+inline SegmentDisplayState get_display_state(const struct SegmentDisplay *display) {
+  return decode_display(display).state;
 }
 
 /**
  * Gets height value from display if state is SD_STATE_HEIGHT
  */
 inline float get_display_height(const struct SegmentDisplay *display) {
-  if (get_display_state(display) != SD_STATE_HEIGHT) return 0;
-
-  float height = segment_to_digit(display->segment1) * 100 + segment_to_digit(display->segment2) * 10 + segment_to_digit(display->segment3);
-  if (is_decimal(display->segment2)) {
-    return height / 10;
-  }
-  return height;
+  return decode_display(display).height;
 }
 
 /**
  * Gets alarm timer value from display if state is SD_STATE_TIMER_DURATION_ON*
  */
 inline uint8_t get_alarm_minutes(const struct SegmentDisplay *display) {
-  auto state = get_display_state(display);
-  if (state != SD_STATE_TIMER_DURATION_ON
-      && state != SD_STATE_TIMER_DURATION_ONLY) return 0;
-
-  uint8_t minutes = segment_to_digit(display->segment2) * 10 + segment_to_digit(display->segment3);
-  return minutes;
+  return decode_display(display).minutes;
 }
 
 } // namespace loctekmotion_desk
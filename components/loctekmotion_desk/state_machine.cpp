@@ -1,7 +1,8 @@
 #include "state_machine.h"
-#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
 
+#include <cstddef>
+
 namespace esphome {
 namespace loctekmotion_desk {
 
@@ -48,132 +49,158 @@ const LogString* desk_control_state_to_string(DeskControlState state) {
 
 // ---------------------------------
 
+enum TransitionGuard : uint8_t {
+  GUARD_NONE = 0,
+  GUARD_HEIGHT_CHANGED = 1,
+  GUARD_TIMER_DONE = 2,
+};
+
+/**
+ * Moves to `target` on `trigger` when in `from` state. If there is a guard,
+ * moves to `target` only when the guard passes, and to `otherwise` when it doesn't.
+ */
+struct TransitionRule {
+  DeskControlState from;
+  DeskControlTrigger trigger;
+  DeskControlState target;
+  TransitionGuard guard{GUARD_NONE};
+  DeskControlState otherwise{DC_STATE_UNKNOWN};
+};
+
+static constexpr TransitionRule TRANSITION_RULES[] = {
+  {DC_STATE_UNKNOWN, SD_STATE_OFF, DC_STATE_OFF},
+  {DC_STATE_UNKNOWN, SD_STATE_TIMER_DURATION_ON, DC_STATE_TIMER_ON},
+  {DC_STATE_UNKNOWN, SD_STATE_TIMER_DURATION_ONLY, DC_STATE_TIMER_ON},
+
+  {DC_STATE_OFF, SD_STATE_OFF, DC_STATE_OFF},
+  {DC_STATE_OFF, SD_STATE_MEMORY, DC_STATE_MEMORY},
+  {DC_STATE_OFF, SD_STATE_HEIGHT, DC_STATE_HEIGHT},
+  {DC_STATE_OFF, SD_STATE_TIMER_ON, DC_STATE_TIMER_STARTING},
+
+  {DC_STATE_MEMORY, SD_STATE_MEMORY, DC_STATE_MEMORY},
+  {DC_STATE_MEMORY, SD_STATE_HEIGHT, DC_STATE_HEIGHT},
+
+  {DC_STATE_HEIGHT, SD_STATE_OFF, DC_STATE_OFF},
+  {DC_STATE_HEIGHT, SD_STATE_MEMORY, DC_STATE_MEMORY},
+  {DC_STATE_HEIGHT, SD_STATE_HEIGHT, DC_STATE_MOVING, GUARD_HEIGHT_CHANGED, DC_STATE_HEIGHT},
+  {DC_STATE_HEIGHT, SD_STATE_TIMER_ON, DC_STATE_TIMER_STARTING},
+  {DC_STATE_HEIGHT, SD_STATE_TIMER_DURATION_ON, DC_STATE_TIMER_ON},
+  {DC_STATE_HEIGHT, SD_STATE_TIMER_DURATION_ONLY, DC_STATE_TIMER_ON},
+
+  {DC_STATE_MOVING, SD_STATE_HEIGHT, DC_STATE_MOVING, GUARD_HEIGHT_CHANGED, DC_STATE_HEIGHT},
+
+  {DC_STATE_TIMER_STARTING, SD_STATE_TIMER_ON, DC_STATE_TIMER_STARTING},
+  {DC_STATE_TIMER_STARTING, SD_STATE_TIMER_DURATION_ON, DC_STATE_TIMER_CHANGE},
+  {DC_STATE_TIMER_STARTING, SD_STATE_TIMER_DURATION_OFF, DC_STATE_TIMER_CHANGE},
+
+  {DC_STATE_TIMER_CHANGE, SD_STATE_TIMER_DURATION_ON, DC_STATE_TIMER_CHANGE},
+  {DC_STATE_TIMER_CHANGE, SD_STATE_TIMER_DURATION_OFF, DC_STATE_TIMER_CHANGE},
+  {DC_STATE_TIMER_CHANGE, SD_STATE_TIMER_DURATION_ONLY, DC_STATE_TIMER_ON},
+  {DC_STATE_TIMER_CHANGE, SD_STATE_TIMER_OFF, DC_STATE_TIMER_OFF},
+
+  {DC_STATE_TIMER_ON, SD_STATE_TIMER_DURATION_ON, DC_STATE_TIMER_DONE, GUARD_TIMER_DONE, DC_STATE_TIMER_ON},
+  {DC_STATE_TIMER_ON, SD_STATE_TIMER_DURATION_ONLY, DC_STATE_TIMER_DONE, GUARD_TIMER_DONE, DC_STATE_TIMER_ON},
+  {DC_STATE_TIMER_ON, SD_STATE_TIMER_DURATION_OFF, DC_STATE_TIMER_CHANGE},
+  {DC_STATE_TIMER_ON, SD_STATE_HEIGHT, DC_STATE_TIMER_MOVING},
+  {DC_STATE_TIMER_ON, SD_STATE_TIMER_OFF, DC_STATE_TIMER_OFF},
+  {DC_STATE_TIMER_ON, SD_STATE_MEMORY, DC_STATE_MEMORY},
+
+  {DC_STATE_TIMER_MOVING, SD_STATE_HEIGHT, DC_STATE_TIMER_MOVING},
+  {DC_STATE_TIMER_MOVING, SD_STATE_TIMER_DURATION_ON, DC_STATE_TIMER_ON},
+  {DC_STATE_TIMER_MOVING, SD_STATE_TIMER_DURATION_ONLY, DC_STATE_TIMER_ON},
+
+  {DC_STATE_TIMER_DONE, SD_STATE_TIMER_DURATION_ON, DC_STATE_TIMER_DONE},
+  {DC_STATE_TIMER_DONE, SD_STATE_TIMER_DURATION_ONLY, DC_STATE_TIMER_DONE},
+  {DC_STATE_TIMER_DONE, SD_STATE_HEIGHT, DC_STATE_HEIGHT},
+  {DC_STATE_TIMER_DONE, SD_STATE_TIMER_DURATION_OFF, DC_STATE_TIMER_CHANGE},
+  {DC_STATE_TIMER_DONE, SD_STATE_TIMER_OFF, DC_STATE_TIMER_OFF},
+
+  {DC_STATE_TIMER_OFF, SD_STATE_TIMER_OFF, DC_STATE_TIMER_OFF},
+  {DC_STATE_TIMER_OFF, SD_STATE_HEIGHT, DC_STATE_HEIGHT},
+};
+
+struct Transition {
+  DeskControlState target;    // DC_STATE_UNKNOWN if there is no transition
+  TransitionGuard guard;
+  DeskControlState otherwise;
+};
+
+struct TransitionTable {
+  Transition transitions[DC_STATE_COUNT][SD_STATE_COUNT];
+};
+
+constexpr TransitionTable make_transition_table() {
+  TransitionTable table{};
+  for (const auto &rule : TRANSITION_RULES) {
+    table.transitions[rule.from][rule.trigger] = {rule.target, rule.guard, rule.otherwise};
+  }
+  return table;
+}
+
+/**
+ * Each state/trigger pair must have at most one rule, every state must be reachable
+ * and have a way out, and guarded rules must define both outcomes.
+ */
+constexpr bool validate_transition_rules() {
+  for (size_t i = 0; i < sizeof(TRANSITION_RULES) / sizeof(TransitionRule); i++) {
+    const auto &rule = TRANSITION_RULES[i];
+    if (rule.from >= DC_STATE_COUNT || rule.trigger >= SD_STATE_COUNT || rule.target >= DC_STATE_COUNT)
+      return false;
+    if (rule.target == DC_STATE_UNKNOWN)
+      return false;
+    if ((rule.guard == GUARD_NONE) != (rule.otherwise == DC_STATE_UNKNOWN))
+      return false;
+    for (size_t j = i + 1; j < sizeof(TRANSITION_RULES) / sizeof(TransitionRule); j++) {
+      if (TRANSITION_RULES[j].from == rule.from && TRANSITION_RULES[j].trigger == rule.trigger)
+        return false;
+    }
+  }
+  for (uint8_t state = DC_STATE_UNKNOWN; state < DC_STATE_COUNT; state++) {
+    bool reachable = state == DC_STATE_UNKNOWN;
+    bool has_exit = false;
+    for (const auto &rule : TRANSITION_RULES) {
+      if (rule.target == state || rule.otherwise == state)
+        reachable = true;
+      if (rule.from == state && (rule.target != state || rule.guard != GUARD_NONE))
+        has_exit = true;
+    }
+    if (!reachable || !has_exit)
+      return false;
+  }
+  return true;
+}
+
+static_assert(validate_transition_rules(), "Invalid desk state machine transition rules");
+static_assert(SD_STATE_COUNT <= 16, "Unhandled triggers are tracked in a 16 bit mask");
+
+static constexpr TransitionTable TRANSITION_TABLE PROGMEM = make_transition_table();
+
+// ---------------------------------
+
 DeskStateMachine::DeskStateMachine() {}
 
 bool DeskStateMachine::transition(DeskControlTrigger trigger) {
     DeskControlState new_state = DC_STATE_UNKNOWN;
 
-    switch (current_state_) {
-        case DC_STATE_UNKNOWN:
-            if (trigger == SD_STATE_OFF) {
-                new_state = DC_STATE_OFF;
-            } else if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_ONLY) {
-                new_state = DC_STATE_TIMER_ON;
-            }
-            break;
-        case DC_STATE_OFF:
-            if (trigger == SD_STATE_OFF) {
-                new_state = current_state_;
-            } else if (trigger == SD_STATE_MEMORY) {
-                new_state = DC_STATE_MEMORY;
-            } else if (trigger == SD_STATE_HEIGHT) {
-                new_state = DC_STATE_HEIGHT;
-            } else if (trigger == SD_STATE_TIMER_ON) {
-                new_state = DC_STATE_TIMER_STARTING;
-            }
-            break;
-
-        case DC_STATE_MEMORY:
-            if (trigger == SD_STATE_MEMORY) {
-                new_state = current_state_;
-            } else if (trigger == SD_STATE_HEIGHT) {
-                new_state = DC_STATE_HEIGHT;
-            }
-            break;
-
-        case DC_STATE_HEIGHT:
-            if (trigger == SD_STATE_OFF) {
-                new_state = DC_STATE_OFF;
-            } else if (trigger == SD_STATE_MEMORY) {
-                new_state = DC_STATE_MEMORY;
-            } else if (trigger == SD_STATE_HEIGHT) {
-                if (has_height_changed()) {
-                    new_state = DC_STATE_MOVING;
-                } else {
-                  new_state = current_state_;
-                }
-            } else if (trigger == SD_STATE_TIMER_ON) {
-                new_state = DC_STATE_TIMER_STARTING;
-            } else if (trigger == SD_STATE_TIMER_DURATION_ON) {
-                new_state = DC_STATE_TIMER_ON;
-            } else if (trigger == SD_STATE_TIMER_DURATION_ONLY) {
-                new_state = DC_STATE_TIMER_ON;
-            } else if (trigger == SD_STATE_MEMORY) {
-                new_state = DC_STATE_MEMORY;
-            }
-            break;
-
-        case DC_STATE_MOVING:
-            if (trigger == SD_STATE_HEIGHT) {
-              if (!has_height_changed()) {
-                new_state = DC_STATE_HEIGHT;
-              } else {
-                new_state = current_state_;
-              }
-            }
-            break;
-
-        case DC_STATE_TIMER_STARTING:
-            if (trigger == SD_STATE_TIMER_ON) {
-                new_state = current_state_;
-            } else if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_OFF) {
-                new_state = DC_STATE_TIMER_CHANGE;
-            }
-            break;
-
-        case DC_STATE_TIMER_CHANGE:
-            if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_OFF) {
-                new_state = current_state_;
-            } else if (trigger == SD_STATE_TIMER_DURATION_ONLY) {
-                new_state = DC_STATE_TIMER_ON;
-            } else if (trigger == SD_STATE_TIMER_OFF) {
-                new_state = DC_STATE_TIMER_OFF;
-            }
-            break;
-
-        case DC_STATE_TIMER_ON:
-            if ((trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_ONLY) && is_timer_done()) {
-                new_state = DC_STATE_TIMER_DONE;
-            } else if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_ONLY) {
-                new_state = current_state_;
-            } else if (trigger == SD_STATE_TIMER_DURATION_OFF) {
-                new_state = DC_STATE_TIMER_CHANGE;
-            } else if (trigger == SD_STATE_HEIGHT) {
-                new_state = DC_STATE_TIMER_MOVING;
-            } else if (trigger == SD_STATE_TIMER_OFF) {
-                new_state = DC_STATE_TIMER_OFF;
-            } else if (trigger == SD_STATE_MEMORY) {
-                new_state = DC_STATE_MEMORY;
-            }
-            break;
-
-        case DC_STATE_TIMER_MOVING:
-            if (trigger == SD_STATE_HEIGHT) {
-                new_state = current_state_;
-            } else if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_ONLY) {
-                new_state = DC_STATE_TIMER_ON;
-            }
-            break;
-
-        case DC_STATE_TIMER_DONE:
-            if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_ONLY) {
-                new_state = current_state_;
-            } else if (trigger == SD_STATE_HEIGHT) {
-                new_state = DC_STATE_HEIGHT;
-            } else if (trigger == SD_STATE_TIMER_DURATION_OFF) {
-                new_state = DC_STATE_TIMER_CHANGE;
-            } else if (trigger == SD_STATE_TIMER_OFF) {
-                new_state = DC_STATE_TIMER_OFF;
-            }
-            break;
-
-        case DC_STATE_TIMER_OFF:
-            if (trigger == SD_STATE_TIMER_OFF) {
-                new_state = current_state_;
-            } else if (trigger == SD_STATE_HEIGHT) {
-                new_state = DC_STATE_HEIGHT;
-            }
-            break;
+    if (current_state_ < DC_STATE_COUNT && trigger < SD_STATE_COUNT) {
+      // table lives in flash on ESP8266, so read it byte by byte
+      const auto *entry = reinterpret_cast<const uint8_t *>(&TRANSITION_TABLE.transitions[current_state_][trigger]);
+      new_state = static_cast<DeskControlState>(progmem_read_byte(&entry[offsetof(Transition, target)]));
+
+      bool guard_passed = true;
+      switch (static_cast<TransitionGuard>(progmem_read_byte(&entry[offsetof(Transition, guard)]))) {
+        case GUARD_HEIGHT_CHANGED:
+          guard_passed = has_height_changed();
+          break;
+        case GUARD_TIMER_DONE:
+          guard_passed = is_timer_done();
+          break;
+        case GUARD_NONE:
+          break;
+      }
+      if (!guard_passed) {
+        new_state = static_cast<DeskControlState>(progmem_read_byte(&entry[offsetof(Transition, otherwise)]));
+      }
     }
 
     if (trigger == SD_STATE_HEIGHT) {
@@ -181,12 +208,24 @@ bool DeskStateMachine::transition(DeskControlTrigger trigger) {
     }
 
     if (new_state == DC_STATE_UNKNOWN) {
-      ESP_LOGW(TAG, "No transition available from %s on %s", LOG_STR_ARG(desk_control_state_to_string(current_state_)),
-                LOG_STR_ARG(segment_display_state_to_string(trigger)));
-    } else if (new_state != current_state_) {      
-      ESP_LOGI(TAG, "Control state changed from %s to %s on trigger %s", LOG_STR_ARG(desk_control_state_to_string(current_state_)),
+      LOCTEKMOTION_DESK_TRACE_TRANSITION(this->trace_, millis(), current_state_, trigger, new_state, height_current_,
+                                         timer_duration_current_);
+      uint16_t trigger_bit = 1 << (trigger < SD_STATE_COUNT ? trigger : SD_STATE_UNKNOWN);
+      if ((unhandled_triggers_ & trigger_bit) == 0) {
+        ESP_LOGW(TAG, "No transition available from %s on %s", LOG_STR_ARG(desk_control_state_to_string(current_state_)),
+                  LOG_STR_ARG(segment_display_state_to_string(trigger)));
+        unhandled_triggers_ |= trigger_bit;
+      }
+      return false;
+    }
+
+    if (new_state != current_state_) {
+      LOCTEKMOTION_DESK_TRACE_TRANSITION(this->trace_, millis(), current_state_, trigger, new_state, height_current_,
+                                         timer_duration_current_);
+      ESP_LOGD(TAG, "Control state changed from %s to %s on trigger %s", LOG_STR_ARG(desk_control_state_to_string(current_state_)),
                 LOG_STR_ARG(desk_control_state_to_string(new_state)), LOG_STR_ARG(segment_display_state_to_string(trigger)));
       current_state_ = new_state;
+      unhandled_triggers_ = 0;
       return true;
     }
 
@@ -1,7 +1,8 @@
 #pragma once
 
+// only depends on segment_display.h, the logger and the build defines, so it can be built without the rest of ESPHome
 #include "segment_display.h"
-#include "esphome/core/component.h"
+#include "transition_trace.h"
 
 namespace esphome {
 namespace loctekmotion_desk {
@@ -20,25 +21,34 @@ enum DeskControlState : uint8_t {
   DC_STATE_TIMER_DONE = 10,
 };
 
+const uint8_t DC_STATE_COUNT = DC_STATE_TIMER_DONE + 1;
+
 using DeskControlTrigger = SegmentDisplayState;
 
+const LogString *segment_display_state_to_string(SegmentDisplayState state);
+const LogString *desk_control_state_to_string(DeskControlState state);
+
 class DeskStateMachine {
 public:
     DeskStateMachine();
-    float height() {
+    float height() const {
       return height_current_;
     }
     void set_height(const float height) {
       height_current_ = height;
     }
-    uint8_t timer_duration() {
+    uint8_t timer_duration() const {
       return timer_duration_current_;
     }
     void set_timer_duration(const uint8_t minutes) {
       timer_duration_current_ = minutes;
     }
     bool transition(DeskControlTrigger trigger);
-    DeskControlState current_state() { return this->current_state_; }
+    DeskControlState current_state() const { return this->current_state_; }
+#ifdef USE_LOCTEKMOTION_DESK_TRANSITION_TRACE
+    TransitionTrace &trace() { return this->trace_; }
+    const TransitionTrace &trace() const { return this->trace_; }
+#endif
 
 private:
     bool has_height_changed() const {
@@ -53,6 +63,11 @@ private:
     float height_previous_ = 0;
     uint8_t timer_duration_current_ = 0;
     uint8_t timer_duration_previous_ = 0;
+    // triggers already warned about in the current state, so a stuck state logs them once instead of on every frame
+    uint16_t unhandled_triggers_ = 0;
+#ifdef USE_LOCTEKMOTION_DESK_TRANSITION_TRACE
+    TransitionTrace trace_;
+#endif
 };
 
 } // namespace loctekmotion_desk
@@ -0,0 +1,76 @@
+#include "transition_trace.h"
+#include "state_machine.h"
+#include "esphome/core/log.h"
+
+#include <cinttypes>
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+static const char *const TAG = "loctekmotion_desk.transition_trace";
+
+void TransitionTrace::init(size_t capacity) {
+  if (capacity == 0)
+    return;
+  this->records_ = new TransitionRecord[capacity];
+  this->capacity_ = capacity;
+}
+
+void TransitionTrace::record(uint32_t now, DeskControlState from, SegmentDisplayState trigger, DeskControlState to,
+                             float height, uint8_t minutes) {
+  if (this->records_ == nullptr)
+    return;
+
+  // a stuck state sees the same trigger on every frame, so count those instead of filling the buffer
+  if (to == DC_STATE_UNKNOWN && this->size_ > 0) {
+    TransitionRecord &last = this->at_(this->size_ - 1);
+    if (last.to == DC_STATE_UNKNOWN && last.from == from && last.trigger == trigger) {
+      if (last.repeats < UINT8_MAX)
+        last.repeats++;
+      return;
+    }
+  }
+
+  if (this->size_ == this->capacity_) {
+    this->tail_ = (this->tail_ + 1) % this->capacity_;
+    this->size_--;
+    this->dropped_records_++;
+  }
+  TransitionRecord &record = this->at_(this->size_);
+  this->size_++;
+  record.time = now;
+  record.height = height > 0 ? (uint16_t) (height * 10 + 0.5f) : 0;
+  record.minutes = minutes;
+  record.from = from;
+  record.trigger = trigger;
+  record.to = to;
+  record.repeats = 0;
+}
+
+void TransitionTrace::dump() const {
+  if (this->records_ == nullptr) {
+    ESP_LOGW(TAG, "Transition trace is not enabled");
+    return;
+  }
+
+  ESP_LOGI(TAG, "TT BEGIN %u records, %" PRIu32 " records dropped", (unsigned) this->size_, this->dropped_records_);
+  for (size_t i = 0; i < this->size_; i++) {
+    const TransitionRecord &record = this->at_(i);
+    const auto from = static_cast<DeskControlState>(record.from);
+    const auto trigger = static_cast<SegmentDisplayState>(record.trigger);
+    if (record.to == DC_STATE_UNKNOWN) {
+      ESP_LOGI(TAG, "TT: %10" PRIu32 " %s on %s: no transition (%u frames), %u.%u cm, %u min", record.time,
+               LOG_STR_ARG(desk_control_state_to_string(from)), LOG_STR_ARG(segment_display_state_to_string(trigger)),
+               record.repeats + 1u, record.height / 10u, record.height % 10u, record.minutes);
+    } else {
+      ESP_LOGI(TAG, "TT: %10" PRIu32 " %s on %s: %s, %u.%u cm, %u min", record.time,
+               LOG_STR_ARG(desk_control_state_to_string(from)), LOG_STR_ARG(segment_display_state_to_string(trigger)),
+               LOG_STR_ARG(desk_control_state_to_string(static_cast<DeskControlState>(record.to))),
+               record.height / 10u, record.height % 10u, record.minutes);
+    }
+  }
+  ESP_LOGI(TAG, "TT END");
+}
+
+} // namespace loctekmotion_desk
+} // namespace esphome
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "segment_display.h"
+#include "esphome/core/defines.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+enum DeskControlState : uint8_t;
+
+/**
+ * One state machine transition, or a run of identical triggers that had no transition (to is DC_STATE_UNKNOWN).
+ */
+struct TransitionRecord {
+  uint32_t time;     // millis() of the (first) trigger
+  uint16_t height;   // tenths of a cm
+  uint8_t minutes;   // timer duration
+  uint8_t from;      // DeskControlState
+  uint8_t trigger;   // SegmentDisplayState
+  uint8_t to;        // DeskControlState
+  uint8_t repeats;   // further identical triggers without a transition, saturates at 255
+};
+
+/**
+ * Keeps the most recent state machine transitions in a fixed size RAM ring buffer,
+ * dropping the oldest records when full. Recording is a few stores, the names are only
+ * looked up when dumping.
+ */
+class TransitionTrace {
+ public:
+  /**
+   * Allocates the buffer. Called once from setup(). A capacity of 0 leaves the trace disabled.
+   */
+  void init(size_t capacity);
+
+  void record(uint32_t now, DeskControlState from, SegmentDisplayState trigger, DeskControlState to, float height,
+              uint8_t minutes);
+
+  /**
+   * Logs the records, oldest first
+   */
+  void dump() const;
+
+  size_t size() const { return this->size_; }
+  size_t capacity() const { return this->capacity_; }
+  uint32_t dropped_records() const { return this->dropped_records_; }
+
+ protected:
+  TransitionRecord &at_(size_t index) { return this->records_[(this->tail_ + index) % this->capacity_]; }
+  const TransitionRecord &at_(size_t index) const { return this->records_[(this->tail_ + index) % this->capacity_]; }
+
+  TransitionRecord *records_{nullptr};
+  size_t capacity_{0};
+  size_t tail_{0};  // oldest record
+  size_t size_{0};
+  uint32_t dropped_records_{0};
+};
+
+} // namespace loctekmotion_desk
+} // namespace esphome
+
+/**
+ * Trace point, compiled to nothing (arguments included) without a transition trace
+ */
+#ifdef USE_LOCTEKMOTION_DESK_TRANSITION_TRACE
+#define LOCTEKMOTION_DESK_TRACE_TRANSITION(trace, ...) (trace).record(__VA_ARGS__)
+#else
+#define LOCTEKMOTION_DESK_TRACE_TRANSITION(trace, ...) \
+  do { \
+  } while (0)
+#endif
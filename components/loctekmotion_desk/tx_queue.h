@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+/**
+ * Outgoing frames with a higher priority are sent first
+ */
+enum TxPriority : uint8_t {
+  TX_PRIORITY_WAKE = 0,    // wake the panel up, e.g. with M
+  TX_PRIORITY_TIMER = 1,   // setting the timer
+  TX_PRIORITY_MOTION = 2,  // up/down and presets
+  TX_PRIORITY_STOP = 3,    // release all keys
+};
+
+const size_t TX_FRAME_MAX_SIZE = 8;  // key frames are 8 bytes
+
+struct TxFrame {
+  uint8_t data[TX_FRAME_MAX_SIZE];
+  uint8_t length;
+  TxPriority priority;
+  uint32_t queued_time;  // for dropping stale frames
+  uint32_t sequence;     // queue order, frames pushed in the same millisecond still have one
+
+  bool same_data(const uint8_t *other, uint8_t other_length) const {
+    return length == other_length && memcmp(data, other, length) == 0;
+  }
+};
+
+enum TxPushResult : uint8_t {
+  TX_QUEUED = 0,
+  TX_COALESCED = 1,  // the same frame was already waiting to be sent
+  TX_REPLACED = 2,   // queue was full, a lower priority frame was dropped
+  TX_REJECTED = 3,   // queue was full of frames with the same or higher priority, or the frame is too long
+};
+
+/**
+ * Bounded queue of outgoing frames. Frames are sent by priority and then in the order they were queued.
+ * Small enough to scan linearly.
+ */
+template<size_t N> class TxQueue {
+  static_assert(N > 0 && N <= 255, "TxQueue count is 8 bit");
+
+ public:
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+
+  TxPushResult push(const uint8_t *data, size_t length, TxPriority priority, uint32_t now) {
+    if (length == 0 || length > TX_FRAME_MAX_SIZE)
+      return TX_REJECTED;
+
+    for (uint8_t i = 0; i < count_; i++) {
+      if (frames_[i].same_data(data, length)) {
+        // pressing the same key again before it was sent does nothing, but it may be more urgent now
+        if (priority > frames_[i].priority)
+          frames_[i].priority = priority;
+        return TX_COALESCED;
+      }
+    }
+
+    TxPushResult result = TX_QUEUED;
+    uint8_t index = count_;
+    if (count_ == N) {
+      index = find_(false);
+      if (frames_[index].priority >= priority)
+        return TX_REJECTED;
+      result = TX_REPLACED;
+    } else {
+      count_++;
+    }
+
+    TxFrame &frame = frames_[index];
+    memcpy(frame.data, data, length);
+    frame.length = length;
+    frame.priority = priority;
+    frame.queued_time = now;
+    frame.sequence = next_sequence_++;
+    return result;
+  }
+
+  bool pop(TxFrame *frame) {
+    if (count_ == 0)
+      return false;
+    uint8_t index = find_(true);
+    *frame = frames_[index];
+    remove_(index);
+    return true;
+  }
+
+  /**
+   * Drops frames that waited longer than max_age, a late key press does more harm than a dropped one
+   */
+  size_t remove_older_than(uint32_t now, uint32_t max_age) {
+    size_t removed = 0;
+    for (uint8_t i = 0; i < count_;) {
+      if (now - frames_[i].queued_time > max_age) {
+        remove_(i);
+        removed++;
+      } else {
+        i++;
+      }
+    }
+    return removed;
+  }
+
+  size_t remove_priority(TxPriority priority) {
+    size_t removed = 0;
+    for (uint8_t i = 0; i < count_;) {
+      if (frames_[i].priority == priority) {
+        remove_(i);
+        removed++;
+      } else {
+        i++;
+      }
+    }
+    return removed;
+  }
+
+  void clear() { count_ = 0; }
+
+ protected:
+  // finds the oldest frame with the highest priority to send next,
+  // or the newest frame with the lowest priority to drop
+  uint8_t find_(bool next) const {
+    uint8_t found = 0;
+    for (uint8_t i = 1; i < count_; i++) {
+      const TxFrame &a = frames_[i];
+      const TxFrame &b = frames_[found];
+      bool older = (int32_t) (a.sequence - b.sequence) < 0;
+      if (next ? (a.priority > b.priority || (a.priority == b.priority && older))
+               : (a.priority < b.priority || (a.priority == b.priority && !older)))
+        found = i;
+    }
+    return found;
+  }
+
+  void remove_(uint8_t index) {
+    // order is kept by sequence, so the last frame can fill the gap
+    count_--;
+    if (index != count_)
+      frames_[index] = frames_[count_];
+  }
+
+  TxFrame frames_[N];
+  uint8_t count_{0};
+  uint32_t next_sequence_{0};
+};
+
+}  // namespace loctekmotion_desk
+}  // namespace esphome
@@ -0,0 +1,59 @@
+#include "usage_statistics.h"
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+void UsageStatistics::set_posture(DeskPosture posture, uint32_t now) {
+  if (posture == this->posture_)
+    return;
+  this->update(now);
+  this->posture_ = posture;
+  this->posture_time_ = now;
+  if (posture == POSTURE_UNKNOWN)
+    return;
+
+  if (this->totals_.last_posture != POSTURE_UNKNOWN && this->totals_.last_posture != posture)
+    this->totals_.posture_changes++;
+  if (this->totals_.last_posture != posture) {
+    this->totals_.last_posture = posture;
+    this->changed_ = true;
+  }
+}
+
+void UsageStatistics::update(uint32_t now) {
+  // now may be before the last update when it's the time of the last frame before the link dropped
+  if (this->posture_ == POSTURE_UNKNOWN || (int32_t) (now - this->posture_time_) < 1000)
+    return;
+  uint32_t seconds = (now - this->posture_time_) / 1000;
+  // whole seconds only, the remainder is credited with the next update
+  this->posture_time_ += seconds * 1000;
+  if (this->posture_ == POSTURE_STANDING) {
+    this->totals_.standing_seconds += seconds;
+  } else {
+    this->totals_.sitting_seconds += seconds;
+  }
+  this->changed_ = true;
+}
+
+void UsageStatistics::add_motor_time(int8_t direction, uint32_t ms) {
+  if (direction > 0) {
+    this->totals_.motor_up_ms += ms;
+  } else {
+    this->totals_.motor_down_ms += ms;
+  }
+  this->changed_ = true;
+}
+
+void UsageStatistics::count_timer_completion() {
+  this->totals_.timer_completions++;
+  this->changed_ = true;
+}
+
+bool UsageStatistics::take_changed() {
+  bool changed = this->changed_;
+  this->changed_ = false;
+  return changed;
+}
+
+} // namespace loctekmotion_desk
+} // namespace esphome
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace loctekmotion_desk {
+
+enum DeskPosture : uint8_t {
+  POSTURE_UNKNOWN = 0,  // not known yet, or the link is down
+  POSTURE_SITTING = 1,
+  POSTURE_STANDING = 2,
+};
+
+/**
+ * Usage totals since they were first recorded, persisted
+ */
+struct UsageTotals {
+  uint32_t sitting_seconds;
+  uint32_t standing_seconds;
+  uint32_t posture_changes;  // sitting to standing and back
+  uint32_t motor_up_ms;
+  uint32_t motor_down_ms;
+  uint32_t timer_completions;
+  DeskPosture last_posture;  // to count a change across reboots and link drops
+};
+
+/**
+ * Accumulates usage totals. Every update is O(1): the time of the current posture is only
+ * credited when the posture changes or the totals are read.
+ */
+class UsageStatistics {
+ public:
+  void restore(const UsageTotals &totals) { this->totals_ = totals; }
+
+  /**
+   * Credits the time of the previous posture and starts timing the new one
+   */
+  void set_posture(DeskPosture posture, uint32_t now);
+  DeskPosture posture() const { return this->posture_; }
+
+  /**
+   * Credits the time of the current posture up to now
+   */
+  void update(uint32_t now);
+
+  void add_motor_time(int8_t direction, uint32_t ms);
+  void count_timer_completion();
+
+  const UsageTotals &totals() const { return this->totals_; }
+
+  /**
+   * Returns true if the totals changed since the last call, to skip writing unchanged totals
+   */
+  bool take_changed();
+
+ protected:
+  UsageTotals totals_{};
+  DeskPosture posture_{POSTURE_UNKNOWN};
+  uint32_t posture_time_{0};  // the posture's time is credited up to here
+  bool changed_{false};
+};
+
+} // namespace loctekmotion_desk
+} // namespace esphome
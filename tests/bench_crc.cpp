@@ -0,0 +1,106 @@
+// Receive path microbenchmark: the table-driven CRC accumulated in DataFrameReader::put() against the
+// bitwise CRC calculated when the frame completes, as before. Host timings only, the ratio is what
+// carries over to the ESP. The CRC table reads are counted exactly: the table is in flash on ESP8266, and
+// put() skips them for repeats of the last display frame. Build it against older component sources to
+// compare (see LOCTEKMOTION_DESK_COMPONENT_DIR in CMakeLists.txt). Usage: loctekmotion_desk_bench_crc [frames]
+
+#include "frames.h"
+#include "segment_display.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace esphome::loctekmotion_desk;
+using esphome::loctekmotion_desk::testing::build_frame;
+using esphome::loctekmotion_desk::testing::display_frame;
+
+namespace {
+
+// the reader before the CRC table: buffers the frame and checks it bit by bit once complete
+struct BitwiseReader {
+  uint8_t raw[DATA_FRAME_MAX_SIZE];
+  uint8_t index{0};
+  uint8_t size{0};
+
+  bool put(uint8_t byte) {
+    if (index == 0 && byte != DATA_FRAME_START)
+      return false;
+    raw[index] = byte;
+    if (index == DATA_LENGTH_INDEX)
+      size = byte + 2;
+    if (index > DATA_LENGTH_INDEX && index + 1 == size) {
+      index = 0;
+      uint16_t crc = CRC16_INIT;
+      for (uint8_t pos = 1; pos < size - 3; pos++)
+        crc = crc16_update_bitwise(crc, raw[pos]);
+      return byte == DATA_FRAME_END && crc == (raw[size - 3] << 8 | raw[size - 2]);
+    }
+    index++;
+    return false;
+  }
+};
+
+template<typename F> double ns_per_byte(const std::vector<uint8_t> &stream, int rounds, F &&parse) {
+  double best = 1e9;
+  for (int round = 0; round < rounds; round++) {
+    auto start = std::chrono::steady_clock::now();
+    parse();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, std::chrono::duration<double, std::nano>(elapsed).count() / stream.size());
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t frame_count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+
+  // like the controller: mostly the same display frame, sometimes another one or another type
+  std::mt19937 rng(42);
+  std::vector<std::vector<uint8_t>> frames;
+  for (int i = 0; i < 4; i++)
+    frames.push_back(display_frame(rng() & 0xFF, rng() & 0xFF, rng() & 0xFF));
+  frames.push_back(build_frame(DATA_TYPE_BEEP, {0x7F}));
+  frames.push_back(build_frame(DATA_TYPE_UNKNOWN_11, {0x01, 0x02}));
+  std::vector<uint8_t> stream;
+  for (size_t i = 0; i < frame_count; i++) {
+    const auto &frame = frames[rng() % 10 < 9 ? 0 : rng() % frames.size()];
+    stream.insert(stream.end(), frame.begin(), frame.end());
+  }
+
+  volatile uint32_t sink = 0;
+  double bitwise = ns_per_byte(stream, 5, [&] {
+    BitwiseReader reader;
+    uint32_t valid = 0;
+    for (uint8_t byte : stream)
+      valid += reader.put(byte);
+    sink = valid;
+  });
+  uint32_t bitwise_valid = sink;
+  uint32_t table_reads = 0;
+  double running = ns_per_byte(stream, 5, [&] {
+    DataFrameReader reader{};
+    reader.reset();
+    uint32_t valid = 0;
+    uint32_t reads_before = esphome::stub::progmem_read_count;
+    for (uint8_t byte : stream)
+      valid += reader.put(byte);
+    table_reads = esphome::stub::progmem_read_count - reads_before;
+    sink = valid;
+  });
+  if (sink != bitwise_valid || sink != frame_count) {
+    fprintf(stderr, "readers disagree: %u / %u of %zu frames\n", (unsigned) bitwise_valid, (unsigned) sink,
+            frame_count);
+    return 1;
+  }
+
+  printf("%zu frames, %zu bytes\n", frame_count, stream.size());
+  printf("bitwise CRC at frame end:   %6.2f ns/byte\n", bitwise);
+  printf("table CRC in put() + repeat: %5.2f ns/byte (%.1fx), %.2f table reads/byte\n", running, bitwise / running,
+         (double) table_reads / stream.size());
+  return 0;
+}
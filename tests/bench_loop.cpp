@@ -0,0 +1,94 @@
+// loop() cost of the component on the host, with the controller silent and while it streams a steady
+// display. Only includes desk.h, so it can be built against older component sources too (see
+// LOCTEKMOTION_DESK_COMPONENT_DIR in CMakeLists.txt). Usage: loctekmotion_desk_bench_loop [loops]
+
+#include "desk.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace esphome;
+using namespace esphome::loctekmotion_desk;
+
+namespace {
+
+const uint32_t LOOP_INTERVAL_MS = 16;
+const uint32_t FRAME_SLOT_MS = 108;
+
+// built here so this file doesn't depend on newer headers
+std::vector<uint8_t> display_frame(uint8_t segment1, uint8_t segment2, uint8_t segment3) {
+  std::vector<uint8_t> frame{0x9b, 0x09, 0x12, segment1, segment2, segment3, 0x00, 0x00};
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 1; i < frame.size(); i++) {
+    crc ^= frame[i];
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+  }
+  frame.push_back(crc >> 8);
+  frame.push_back(crc & 0xFF);
+  frame.push_back(0x9d);
+  return frame;
+}
+
+struct LoopCost {
+  double ns;           // host time, noisy at this scale
+  double millis_calls; // exact, and the call that matters on a device
+};
+
+/**
+ * Average cost of one loop() pass plus the scheduler run after it, over loops passes 16 simulated ms apart. The
+ * whole batch is timed at once, since reading the clock around each pass costs more than the pass itself
+ */
+LoopCost loop_cost(uint32_t loops, bool streaming) {
+  uart::UARTComponent uart;
+  binary_sensor::BinarySensor connected;
+  sensor::Sensor height, timer;
+  LoctekMotionComponent desk(&uart);
+  desk.set_connected_binary_sensor(&connected);
+  desk.set_height_sensor(&height);
+  desk.set_timer_sensor(&timer);
+  stub::set_time(0);
+  desk.setup();
+
+  const auto frame = display_frame(0x07, 0x6d | 0x80, 0x3f);  // 75.0
+  if (streaming)
+    uart.inject(display_frame(0x00, 0x00, 0x00));  // off, so the state machine starts
+  uint32_t now = 0, next_slot = 0;
+  uint32_t millis_calls_before = stub::millis_calls();
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < loops; i++) {
+    if (streaming && now >= next_slot) {
+      uart.inject(frame);
+      next_slot += FRAME_SLOT_MS;
+    }
+    desk.loop();
+    stub::run_scheduler();
+    stub::advance_time(LOOP_INTERVAL_MS);
+    now += LOOP_INTERVAL_MS;
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return {std::chrono::duration<double, std::nano>(elapsed).count() / loops,
+          (double) (stub::millis_calls() - millis_calls_before) / loops};
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uint32_t loops = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000000;
+  stub::set_log_level(ESPHOME_LOG_LEVEL_NONE);
+  printf("%u loops, 16 ms apart, best of 5\n", (unsigned) loops);
+  for (bool streaming : {false, true}) {
+    LoopCost best{1e9, 0};
+    for (int round = 0; round < 5; round++) {
+      LoopCost cost = loop_cost(loops, streaming);
+      best.ns = std::min(best.ns, cost.ns);
+      best.millis_calls = cost.millis_calls;
+    }
+    printf("%-22s %6.1f ns/loop %6.2f millis()/loop\n", streaming ? "display every 108 ms" : "controller silent",
+           best.ns, best.millis_calls);
+  }
+  return 0;
+}
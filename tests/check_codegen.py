@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Imports the component's codegen module and runs its validators.
+
+Catches what the host build can't: a schema that refers to a function defined
+further down, a typo in a name, a validator that rejects a valid config. With
+ESPHome installed it also validates example.yaml with `esphome config`, against
+this checkout instead of the GitHub source. Otherwise ESPHome's modules are
+stubbed and only the import and the plain Python validators are checked.
+
+  check_codegen.py
+"""
+
+import importlib.util
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+from unittest import mock
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+COMPONENT = os.path.join(ROOT, "components", "loctekmotion_desk", "__init__.py")
+ESPHOME_MODULES = [
+    "esphome",
+    "esphome.automation",
+    "esphome.codegen",
+    "esphome.config_validation",
+    "esphome.const",
+    "esphome.components",
+    "esphome.components.binary_sensor",
+    "esphome.components.button",
+    "esphome.components.sensor",
+    "esphome.components.text_sensor",
+    "esphome.components.uart",
+]
+
+
+class Invalid(Exception):
+    pass
+
+
+def stub_esphome():
+    for name in ESPHOME_MODULES:
+        sys.modules[name] = mock.MagicMock(name=name)
+    sys.modules["esphome.config_validation"].Invalid = Invalid
+    for name in ESPHOME_MODULES[1:]:
+        parent, _, child = name.rpartition(".")
+        setattr(sys.modules[parent], child, sys.modules[name])
+
+
+def import_component():
+    spec = importlib.util.spec_from_file_location("loctekmotion_desk", COMPONENT)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def rejects(validator, value):
+    try:
+        validator(value)
+    except sys.modules["esphome.config_validation"].Invalid:
+        return True
+    return False
+
+
+def check_validators(component):
+    on_frame = lambda *frame_types: [{component.CONF_TYPE: frame_type} for frame_type in frame_types]
+    component.validate_frame_types(on_frame(0x14, 0x20))
+    assert rejects(component.validate_frame_types, on_frame(component.FRAME_TYPE_DISPLAY))
+    assert rejects(component.validate_frame_types, on_frame(0x20, 0x20))
+    assert rejects(component.validate_frame_types, on_frame(*range(0x20, 0x20 + component.FRAME_HANDLER_SLOTS)))
+    # 9B 06 02 01 00 FC A0 9D is the up key frame
+    assert component.key_frame_crc(0x01) == 0xFCA0
+    # press_key is queued like the button for its keys
+    keys = component.DESK_KEYS
+    assert component.key_priority(keys["preset2"]) is component.TX_PRIORITY_MOTION
+    assert component.key_priority(keys["timer"]) is component.TX_PRIORITY_TIMER
+    assert component.key_priority(keys["memory"]) is component.TX_PRIORITY_WAKE
+    assert component.key_priority(keys["memory"] | keys["up"]) is component.TX_PRIORITY_MOTION
+
+
+def main():
+    try:
+        import esphome  # noqa: F401
+
+        installed = True
+    except ImportError:
+        installed = False
+        stub_esphome()
+    check_validators(import_component())
+    if installed and shutil.which("esphome"):
+        return check_example()
+    return 0
+
+
+def check_example():
+    with open(os.path.join(ROOT, "example.yaml")) as example:
+        config = example.read()
+    config = config.replace("github://muxa/esphome-loctekmotion-desk",
+                            f"\n      type: local\n      path: {os.path.join(ROOT, 'components')}")
+    with tempfile.TemporaryDirectory() as directory:
+        path = os.path.join(directory, "example.yaml")
+        with open(path, "w") as example:
+            example.write(config)
+        return subprocess.run(["esphome", "config", path], stdout=subprocess.DEVNULL).returncode
+
+
+if __name__ == "__main__":
+    sys.exit(main())
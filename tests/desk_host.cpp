@@ -0,0 +1,203 @@
+// The component on the host, talking to a desk controller on a serial port or pty, like the one
+// tools/desk_simulator.py creates. Runs the commands given after the port one after the other, each until
+// it is done, and exits with 1 if one doesn't finish in time:
+//
+//   loctekmotion_desk_host /tmp/desk wake move_to_height 100 timer_set 3
+//
+//   wake               waits for the controller, then presses M until the height is shown
+//   move_to_height CM  until the move is done
+//   timer_set MIN      until the new countdown started
+//   wait S             keeps running the component for S seconds
+//
+// DESK_LOG_LEVEL sets the log level, e.g. 5 to see the component's debug logs
+
+#include "desk.h"
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+using namespace esphome;
+using namespace esphome::loctekmotion_desk;
+
+namespace {
+
+const uint32_t LOOP_INTERVAL_MS = 16;
+const uint32_t WAKE_TIMEOUT_MS = 5000;
+const uint32_t MOVE_TIMEOUT_MS = 60000;
+const uint32_t TIMER_SET_TIMEOUT_MS = 60000;
+const float MOVE_TOLERANCE_CM = 0.5f;
+
+// the UART on a file descriptor, read into the stub's receive queue
+class SerialPort : public uart::UARTComponent {
+ public:
+  explicit SerialPort(int fd) : fd_(fd) {}
+
+  void write_array(const uint8_t *data, size_t len) override {
+    while (len > 0) {
+      ssize_t written = write(this->fd_, data, len);
+      if (written <= 0)
+        return;
+      data += written;
+      len -= written;
+    }
+  }
+  bool read_array(uint8_t *data, size_t len) override {
+    this->receive_();
+    return uart::UARTComponent::read_array(data, len);
+  }
+  int available() override {
+    this->receive_();
+    return uart::UARTComponent::available();
+  }
+
+ protected:
+  void receive_() {
+    uint8_t buffer[256];
+    ssize_t received;
+    while ((received = read(this->fd_, buffer, sizeof(buffer))) > 0)
+      this->inject(buffer, received);
+  }
+
+  int fd_;
+};
+
+int open_port(const char *path) {
+  int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0)
+    return -1;
+  termios settings;
+  if (tcgetattr(fd, &settings) == 0) {
+    cfmakeraw(&settings);
+    cfsetspeed(&settings, B9600);
+    tcsetattr(fd, TCSANOW, &settings);
+  }
+  return fd;
+}
+
+class Host {
+ public:
+  explicit Host(SerialPort *port) : desk(port) {
+    this->desk.set_height_sensor(&this->height);
+    this->desk.set_timer_sensor(&this->timer);
+    this->desk.add_on_move_to_height_done_callback([this](float height) {
+      this->move_done = true;
+      this->moved_to = height;
+    });
+  }
+
+  /**
+   * Runs the component until the condition holds. Returns false if it didn't within timeout_ms
+   */
+  bool run_until(const std::function<bool()> &condition, uint32_t timeout_ms) {
+    uint32_t start = millis();
+    while (!condition()) {
+      if (millis() - start >= timeout_ms)
+        return false;
+      this->desk.loop();
+      stub::run_scheduler();
+      usleep(LOOP_INTERVAL_MS * 1000);
+    }
+    return true;
+  }
+
+  bool wake() {
+    if (!this->run_until([this] { return this->desk.current_state() != DC_STATE_UNKNOWN; }, WAKE_TIMEOUT_MS)) {
+      printf("wake: no display frames from the controller\n");
+      return false;
+    }
+    if (this->desk.current_state() == DC_STATE_OFF)
+      this->desk.press_keys(KEY_MEMORY, TX_PRIORITY_MOTION);
+    if (!this->run_until([this] { return this->desk.current_state() == DC_STATE_HEIGHT; }, WAKE_TIMEOUT_MS)) {
+      printf("wake: the height is not shown\n");
+      return false;
+    }
+    printf("wake: %.1f cm\n", this->height.state);
+    return true;
+  }
+
+  bool move_to_height(float target) {
+    this->move_done = false;
+    uint32_t start = millis();
+    this->desk.move_to_height(target);
+    if (!this->run_until([this] { return this->move_done; }, MOVE_TIMEOUT_MS)) {
+      printf("move_to_height %.1f: not done, at %.1f cm\n", target, this->height.state);
+      return false;
+    }
+    printf("move_to_height %.1f: %.1f cm in %.2f s\n", target, this->moved_to, (millis() - start) / 1000.0f);
+    return std::fabs(this->moved_to - target) <= MOVE_TOLERANCE_CM;
+  }
+
+  bool timer_set(uint8_t minutes) {
+    uint32_t start = millis();
+    uint32_t publishes = this->timer.publishes;
+    this->desk.set_timer_duration(minutes);
+    // the countdown is anchored to the full duration when the timer starts
+    if (!this->run_until([&] { return this->timer.publishes != publishes && this->timer.state == minutes * 60; },
+                         TIMER_SET_TIMEOUT_MS)) {
+      printf("timer_set %d: not done\n", minutes);
+      return false;
+    }
+    printf("timer_set %d: started in %.2f s\n", minutes, (millis() - start) / 1000.0f);
+    return true;
+  }
+
+  bool wait(float seconds) {
+    this->run_until([] { return false; }, (uint32_t) (seconds * 1000));
+    return true;
+  }
+
+  LoctekMotionComponent desk;
+  sensor::Sensor height, timer;
+  bool move_done{false};
+  float moved_to{NAN};
+};
+
+int usage() {
+  fprintf(stderr, "usage: loctekmotion_desk_host PORT [wake | move_to_height CM | timer_set MIN | wait S]...\n");
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    return usage();
+  int fd = open_port(argv[1]);
+  if (fd < 0) {
+    fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+    return 1;
+  }
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  stub::use_system_clock();
+  SerialPort port(fd);
+  Host host(&port);
+  host.desk.setup();
+
+  for (int i = 2; i < argc; i++) {
+    const char *command = argv[i];
+    bool done;
+    if (strcmp(command, "wake") == 0) {
+      done = host.wake();
+    } else if (i + 1 < argc && strcmp(command, "move_to_height") == 0) {
+      done = host.move_to_height(strtof(argv[++i], nullptr));
+    } else if (i + 1 < argc && strcmp(command, "timer_set") == 0) {
+      done = host.timer_set((uint8_t) atoi(argv[++i]));
+    } else if (i + 1 < argc && strcmp(command, "wait") == 0) {
+      done = host.wait(strtof(argv[++i], nullptr));
+    } else {
+      return usage();
+    }
+    if (!done)
+      return 1;
+  }
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,384 @@
+#pragma once
+
+// The desk controller as tools/desk_simulator.py models it, ported for the simulation tests, and a
+// harness that runs it against the component on the simulated clock
+
+#include "desk.h"
+#include "frames.h"
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace testing {
+
+const uint32_t KEY_HOLD_MS = 150;  // a key is released when no frame repeats it for this long
+const float MAX_SPEED = 3.8f;      // cm/s
+const float ACCELERATION = 20.0f;  // cm/s²
+const float DECELERATION = 12.0f;  // cm/s²
+const uint32_t TIMER_ON_SCREEN_MS = 400;
+const uint32_t TIMER_EDIT_TIMEOUT_MS = 5000;
+const uint32_t TIMER_BLINK_MS = 500;
+const uint32_t TIMER_REPEAT_DELAY_MS = 500;
+const uint32_t TIMER_REPEAT_INTERVAL_MS = 100;
+const uint8_t TIMER_DEFAULT_MINUTES = 45;
+const uint32_t TIMER_SHOW_EVERY_MS = 4000;
+const uint32_t TIMER_OFF_SCREEN_MS = 1000;
+const uint32_t TIMER_DONE_SCREEN_MS = 5000;
+const uint32_t MEMORY_SCREEN_MS = 5000;
+const uint32_t BEEP_INTERVAL_MS = 1000;
+
+enum ModelMode : uint8_t {
+  MODEL_OFF,
+  MODEL_HEIGHT,
+  MODEL_MEMORY,
+  MODEL_TIMER_ON,
+  MODEL_TIMER_EDIT,
+  MODEL_TIMER_OFF,
+  MODEL_TIMER_DONE,
+};
+
+struct DeskModelConfig {
+  float height{75.0f};
+  float min_height{72.0f};
+  float max_height{121.0f};
+  float presets[3]{75.0f, 110.0f, 90.0f};
+  uint32_t sleep_ms{10000};
+  uint32_t timer_minute_ms{60000};
+  bool key_repeat{true};  // held up/down repeat while changing the timer duration
+};
+
+/**
+ * The controller, advanced one frame slot at a time
+ */
+class DeskModel {
+ public:
+  explicit DeskModel(const DeskModelConfig &config) : config_(config), height(config.height) {
+    for (int i = 0; i < 3; i++)
+      this->presets[i] = config.presets[i];
+  }
+
+  void key_frame(uint8_t keys, uint32_t now) {
+    uint8_t held = now - this->key_time_ < KEY_HOLD_MS ? this->keys_ : 0;
+    bool new_press = keys != held;
+    this->keys_ = keys;
+    this->key_time_ = now;
+    if (keys)
+      this->last_key_time_ = now;
+    if (new_press) {
+      this->key_press_time_ = now;
+      this->repeat_time_ = now;
+      if (keys)
+        this->press_(keys, now);
+    } else if (keys && this->mode == MODEL_TIMER_EDIT && (keys == KEY_UP || keys == KEY_DOWN) &&
+               this->config_.key_repeat) {
+      if (now - this->key_press_time_ >= TIMER_REPEAT_DELAY_MS && now - this->repeat_time_ >= TIMER_REPEAT_INTERVAL_MS) {
+        this->repeat_time_ = now;
+        this->change_timer_(keys == KEY_UP ? 1 : -1, now);
+      }
+    }
+  }
+
+  void step(uint32_t now, uint32_t dt) {
+    uint32_t in_mode = now - this->mode_time_;
+    if (this->mode == MODEL_TIMER_ON && in_mode >= TIMER_ON_SCREEN_MS) {
+      this->set_mode_(MODEL_TIMER_EDIT, now);
+    } else if (this->mode == MODEL_TIMER_EDIT && in_mode >= TIMER_EDIT_TIMEOUT_MS) {
+      this->start_timer_(now);
+    } else if (this->mode == MODEL_MEMORY && in_mode >= MEMORY_SCREEN_MS) {
+      this->set_mode_(MODEL_HEIGHT, now);
+    } else if (this->mode == MODEL_TIMER_OFF && in_mode >= TIMER_OFF_SCREEN_MS) {
+      this->set_mode_(MODEL_HEIGHT, now);
+    } else if (this->mode == MODEL_TIMER_DONE && in_mode >= TIMER_DONE_SCREEN_MS) {
+      this->beeping_ = false;
+      this->set_mode_(MODEL_HEIGHT, now);
+    }
+
+    if (this->timer_running && now - this->timer_minute_start_ >= this->config_.timer_minute_ms) {
+      this->timer_minute_start_ += this->config_.timer_minute_ms;
+      this->timer_minutes--;
+      if (this->timer_minutes == 0) {
+        this->timer_running = false;
+        this->has_target_ = false;
+        this->set_mode_(MODEL_TIMER_DONE, now);
+        this->beeping_ = true;
+        this->beep_time_ = now;
+      }
+    }
+
+    this->move_(now, dt);
+
+    if (this->mode == MODEL_HEIGHT && !this->timer_running && !this->moving() &&
+        now - this->last_key_time_ >= this->config_.sleep_ms)
+      this->set_mode_(MODEL_OFF, now);
+  }
+
+  /**
+   * Frames to send in this slot
+   */
+  std::vector<std::vector<uint8_t>> frames(uint32_t now) {
+    uint8_t s1, s2, s3;
+    this->segments_(now, &s1, &s2, &s3);
+    std::vector<std::vector<uint8_t>> frames{build_frame(DATA_TYPE_DISPLAY, {s1, s2, s3, 0x00, 0x00})};
+    if (this->beeping_ && now >= this->beep_time_) {
+      this->beep_time_ += BEEP_INTERVAL_MS;
+      frames.push_back(build_frame(DATA_TYPE_BEEP, {}));
+    }
+    return frames;
+  }
+
+  bool moving() const { return this->speed != 0 || this->has_target_; }
+
+  float shown_height() const {
+    int tenths = (int) lroundf(this->height * 10);
+    return tenths >= 1000 ? tenths / 10 : tenths / 10.0f;
+  }
+
+  ModelMode mode{MODEL_OFF};
+  float height;
+  float speed{0};
+  float presets[3];
+  uint8_t timer_minutes{0};  // duration being edited, or remaining while running
+  bool timer_running{false};
+
+ protected:
+  void press_(uint8_t keys, uint32_t now) {
+    if (this->mode == MODEL_OFF) {
+      this->set_mode_(MODEL_HEIGHT, now);
+      if (keys == KEY_MEMORY)
+        return;  // only wakes the display
+    }
+    int preset = keys == KEY_PRESET1 ? 0 : keys == KEY_PRESET2 ? 1 : keys == KEY_PRESET3 ? 2 : -1;
+
+    if (keys == KEY_TIMER) {
+      if (this->mode == MODEL_TIMER_EDIT) {
+        this->start_timer_(now);
+      } else if (this->mode != MODEL_TIMER_ON) {
+        this->has_target_ = false;
+        if (this->timer_minutes == 0)
+          this->timer_minutes = TIMER_DEFAULT_MINUTES;
+        this->timer_running = false;
+        this->set_mode_(MODEL_TIMER_ON, now);
+      }
+    } else if (this->mode == MODEL_TIMER_EDIT && (keys == KEY_UP || keys == KEY_DOWN)) {
+      this->change_timer_(keys == KEY_UP ? 1 : -1, now);
+    } else if (keys == KEY_MEMORY) {
+      this->has_target_ = false;
+      this->set_mode_(MODEL_MEMORY, now);
+    } else if (preset >= 0 && this->mode == MODEL_MEMORY) {
+      this->presets[preset] = this->shown_height();
+      this->set_mode_(MODEL_HEIGHT, now);
+    } else if (preset >= 0) {
+      this->target_ = fminf(this->config_.max_height, fmaxf(this->config_.min_height, this->presets[preset]));
+      this->has_target_ = true;
+      this->set_mode_(MODEL_HEIGHT, now);
+    } else if (keys & (KEY_UP | KEY_DOWN)) {
+      this->has_target_ = false;  // any key stops moving to a preset
+      if (this->mode == MODEL_TIMER_DONE || this->mode == MODEL_MEMORY || this->mode == MODEL_TIMER_OFF)
+        this->set_mode_(MODEL_HEIGHT, now);
+    }
+  }
+
+  void change_timer_(int step, uint32_t now) {
+    int minutes = this->timer_minutes + step;
+    this->timer_minutes = minutes < 0 ? 0 : minutes > 99 ? 99 : minutes;
+    this->mode_time_ = now;  // restarts the edit timeout
+  }
+
+  void start_timer_(uint32_t now) {
+    if (this->timer_minutes == 0) {
+      this->timer_running = false;
+      this->set_mode_(MODEL_TIMER_OFF, now);
+      return;
+    }
+    this->timer_running = true;
+    this->timer_minute_start_ = now;
+    this->set_mode_(MODEL_HEIGHT, now);
+  }
+
+  void set_mode_(ModelMode mode, uint32_t now) {
+    this->mode = mode;
+    this->mode_time_ = now;
+  }
+
+  void move_(uint32_t now, uint32_t dt) {
+    uint8_t held = now - this->key_time_ < KEY_HOLD_MS ? this->keys_ : 0;
+    bool motion_keys = this->mode == MODEL_HEIGHT || this->mode == MODEL_OFF;
+    int direction = 0;
+    if (motion_keys && held == KEY_UP) {
+      direction = 1;
+    } else if (motion_keys && held == KEY_DOWN) {
+      direction = -1;
+    } else if (this->has_target_) {
+      // brake in time to stop at the preset
+      float remaining = this->target_ - this->height;
+      float braking = this->speed * this->speed / (2 * DECELERATION);
+      if (fabsf(remaining) > braking + 0.05f)
+        direction = remaining > 0 ? 1 : -1;
+    }
+    float target_speed = direction * MAX_SPEED;
+    float rate = (direction ? ACCELERATION : DECELERATION) * dt / 1000;
+    if (this->speed < target_speed) {
+      this->speed = fminf(target_speed, this->speed + rate);
+    } else if (this->speed > target_speed) {
+      this->speed = fmaxf(target_speed, this->speed - rate);
+    }
+    this->height += this->speed * dt / 1000;
+    if (this->height <= this->config_.min_height || this->height >= this->config_.max_height) {
+      this->height = fminf(this->config_.max_height, fmaxf(this->config_.min_height, this->height));
+      this->speed = 0;
+    }
+    if (this->has_target_ && this->speed == 0 && direction == 0) {
+      if (fabsf(this->target_ - this->height) < 0.3f)
+        this->height = this->target_;
+      this->has_target_ = false;
+    }
+  }
+
+  void segments_(uint32_t now, uint8_t *s1, uint8_t *s2, uint8_t *s3) const {
+    bool blink_off = (now - this->mode_time_) / TIMER_BLINK_MS % 2 == 1;
+    auto minutes = [&](uint8_t first) {
+      *s1 = first;
+      *s2 = DIGITS[this->timer_minutes / 10];
+      *s3 = DIGITS[this->timer_minutes % 10];
+    };
+    switch (this->mode) {
+      case MODEL_OFF:
+        *s1 = *s2 = *s3 = SEGMENT_OFF;
+        return;
+      case MODEL_MEMORY:
+        *s1 = SEGMENT_SYMBOL_S, *s2 = SEGMENT_SYMBOL_DASH, *s3 = SEGMENT_OFF;
+        return;
+      case MODEL_TIMER_ON:
+        *s1 = SEGMENT_OFF, *s2 = SEGMENT_SYMBOL_O, *s3 = SEGMENT_SYMBOL_N;
+        return;
+      case MODEL_TIMER_OFF:
+        *s1 = SEGMENT_SYMBOL_O, *s2 = SEGMENT_SYMBOL_F, *s3 = SEGMENT_SYMBOL_F;
+        return;
+      case MODEL_TIMER_EDIT:
+        if (blink_off) {
+          *s1 = SEGMENT_SYMBOL_COLON, *s2 = *s3 = SEGMENT_OFF;
+          return;
+        }
+        minutes(SEGMENT_SYMBOL_COLON);
+        return;
+      case MODEL_TIMER_DONE:
+        minutes(SEGMENT_SYMBOL_COLON);
+        return;
+      case MODEL_HEIGHT:
+        break;
+    }
+    if (this->timer_running && (now - this->timer_minute_start_) % TIMER_SHOW_EVERY_MS < 1000) {
+      minutes(SEGMENT_OFF);
+      return;
+    }
+    std::vector<uint8_t> frame = height_frame(this->shown_height());
+    *s1 = frame[3], *s2 = frame[4], *s3 = frame[5];
+  }
+
+  DeskModelConfig config_;
+  float target_{0};
+  bool has_target_{false};
+  uint32_t mode_time_{0};
+  uint8_t keys_{0};
+  uint32_t key_time_{(uint32_t) -KEY_HOLD_MS};
+  uint32_t key_press_time_{0};
+  uint32_t repeat_time_{0};
+  uint32_t last_key_time_{0};
+  uint32_t timer_minute_start_{0};
+  bool beeping_{false};
+  uint32_t beep_time_{0};
+};
+
+/**
+ * The component talking to the model over the in-memory UART. The model sends its frames once per
+ * frame slot and acts on the key frames written during the previous one, loop() runs every 16 ms.
+ */
+class DeskSimulation {
+ public:
+  static const uint32_t FRAME_SLOT_MS = 108;
+  static const uint32_t LOOP_INTERVAL_MS = 16;
+
+  explicit DeskSimulation(const DeskModelConfig &config = {}) : model(config), desk(&this->uart) {
+    stub::set_time(0);
+  }
+
+  void setup() { this->desk.setup(); }
+
+  /**
+   * Runs until the condition holds or the time is up. Returns whether the condition held.
+   */
+  bool run_until(const std::function<bool()> &condition, uint32_t timeout_ms) {
+    uint32_t end = millis() + timeout_ms;
+    while ((int32_t) (millis() - end) < 0) {
+      this->tick_();
+      if (condition())
+        return true;
+    }
+    return condition();
+  }
+
+  void run(uint32_t ms) {
+    run_until([] { return false; }, ms);
+  }
+
+  uart::UARTComponent uart;
+  DeskModel model;
+  LoctekMotionComponent desk;
+  std::vector<uint8_t> keys_sent;  // every key frame the model received, in order
+  bool lose_key_frames{false};     // the controller misses the key frames, like on a noisy line
+
+ protected:
+  void tick_() {
+    uint32_t now = millis();
+    if (now >= this->next_slot_) {
+      for (uint8_t keys : this->pending_keys_)
+        this->model.key_frame(keys, now);
+      this->pending_keys_.clear();
+      this->model.step(now, FRAME_SLOT_MS);
+      for (const auto &frame : this->model.frames(now))
+        this->uart.inject(frame);
+      this->next_slot_ = now + FRAME_SLOT_MS;
+    }
+    if (now >= this->next_loop_) {
+      this->desk.loop();
+      stub::run_scheduler();
+      this->read_key_frames_();
+      this->next_loop_ = now + LOOP_INTERVAL_MS;
+    }
+    stub::advance_time(1);
+  }
+
+  void read_key_frames_() {
+    auto &written = this->uart.written();
+    size_t pos = 0;
+    while (written.size() - pos >= KEY_FRAME_SIZE) {
+      if (written[pos] != DATA_FRAME_START) {
+        pos++;
+        continue;
+      }
+      KeyFrame expected = encode_key_frame(written[pos + 3]);
+      if (memcmp(expected.raw, &written[pos], KEY_FRAME_SIZE) != 0) {
+        pos++;
+        continue;
+      }
+      if (!this->lose_key_frames) {
+        this->pending_keys_.push_back(written[pos + 3]);
+        this->keys_sent.push_back(written[pos + 3]);
+      }
+      pos += KEY_FRAME_SIZE;
+    }
+    written.erase(written.begin(), written.begin() + pos);
+  }
+
+  uint32_t next_slot_{0};
+  uint32_t next_loop_{0};
+  std::vector<uint8_t> pending_keys_;
+};
+
+}  // namespace testing
+}  // namespace loctekmotion_desk
+}  // namespace esphome
@@ -0,0 +1,174 @@
+// Replays a flight recorder capture through the host build of the component: the frames go through the
+// UART into its frame reader and state machine at their recorded times, on the simulated clock. Prints
+// what the component made of them and how long it took.
+//
+//   loctekmotion_desk_replay CAPTURE [--speed X] [--repeat N]
+//
+// CAPTURE is a binary capture, see tools/replay_capture.py --save to get one from the device logs.
+// By default the capture is replayed as fast as possible, --speed X paces it at X times real time.
+// --repeat N replays it N times and reports the fastest pass. Exits with 1 if the component didn't get
+// out of the unknown state or never published a height.
+
+#include "desk.h"
+#include "flight_recorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace esphome;
+using namespace esphome::loctekmotion_desk;
+
+namespace {
+
+const uint32_t LOOP_INTERVAL_MS = 16;
+const uint32_t SETTLE_MS = 2000;  // after the last frame, for what the component decodes with a delay
+
+struct Record {
+  uint32_t time_ms;
+  std::vector<uint8_t> frame;  // with the start and end bytes
+};
+
+bool read_varint(const std::vector<uint8_t> &data, size_t &pos, uint32_t &value) {
+  value = 0;
+  for (int shift = 0; pos < data.size() && shift < 32; shift += 7) {
+    uint8_t byte = data[pos++];
+    value |= (uint32_t) (byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * Decodes the capture format described in flight_recorder.h. Returns false if it's not a capture or is cut
+ * short
+ */
+bool decode_capture(const std::vector<uint8_t> &data, std::vector<Record> &records) {
+  size_t header = sizeof(FLIGHT_RECORDER_MAGIC) + 1;
+  if (data.size() < header || memcmp(data.data(), FLIGHT_RECORDER_MAGIC, sizeof(FLIGHT_RECORDER_MAGIC)) != 0 ||
+      data[header - 1] != FLIGHT_RECORDER_VERSION)
+    return false;
+  size_t pos = header;
+  uint32_t time_ms = 0;
+  std::vector<uint8_t> last_frame;
+  while (pos < data.size()) {
+    uint32_t value;
+    if (!read_varint(data, pos, value))
+      return false;
+    time_ms += value >> 1;
+    if (!(value & 1)) {
+      size_t length = data[pos];
+      if (pos + length > data.size())
+        return false;
+      last_frame.assign(1, DATA_FRAME_START);
+      last_frame.insert(last_frame.end(), data.begin() + pos, data.begin() + pos + length);
+      last_frame.push_back(DATA_FRAME_END);
+      pos += length;
+    }
+    if (!last_frame.empty())  // the oldest repeats may refer to a frame that was already dropped
+      records.push_back({time_ms, last_frame});
+  }
+  return true;
+}
+
+struct ReplayResult {
+  double seconds;  // host time, sleeping included when paced
+  uint32_t loops;
+  uint32_t state_changes;
+  DeskControlState state;
+  sensor::Sensor height;
+};
+
+ReplayResult replay(const std::vector<Record> &records, double speed) {
+  ReplayResult result{};
+  uart::UARTComponent uart;
+  LoctekMotionComponent desk(&uart);
+  desk.set_height_sensor(&result.height);
+  stub::set_time(0);
+  desk.setup();
+
+  uint32_t end = records.back().time_ms + SETTLE_MS;
+  DeskControlState state = desk.current_state();
+  size_t next = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t now = 0; now <= end; now += LOOP_INTERVAL_MS) {
+    stub::set_time(now);
+    for (; next < records.size() && records[next].time_ms <= now; next++)
+      uart.inject(records[next].frame);
+    desk.loop();
+    stub::run_scheduler();
+    result.loops++;
+    if (desk.current_state() != state) {
+      state = desk.current_state();
+      result.state_changes++;
+    }
+    if (speed > 0)
+      std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t) (now * 1000 / speed)));
+  }
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.state = state;
+  return result;
+}
+
+int usage() {
+  fprintf(stderr, "usage: loctekmotion_desk_replay CAPTURE [--speed X] [--repeat N]\n");
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    return usage();
+  double speed = 0;
+  uint32_t repeat = 1;
+  for (int i = 2; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "--speed") == 0) {
+      speed = strtod(argv[++i], nullptr);
+    } else if (i + 1 < argc && strcmp(argv[i], "--repeat") == 0) {
+      repeat = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+    } else {
+      return usage();
+    }
+  }
+
+  FILE *file = fopen(argv[1], "rb");
+  if (file == nullptr) {
+    perror(argv[1]);
+    return 1;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data.insert(data.end(), buffer, buffer + read);
+  fclose(file);
+  std::vector<Record> records;
+  if (!decode_capture(data, records) || records.empty()) {
+    fprintf(stderr, "%s: not a flight recorder capture, or an empty one\n", argv[1]);
+    return 1;
+  }
+  size_t bytes = 0;
+  for (auto &record : records)
+    bytes += record.frame.size();
+  double duration = records.back().time_ms / 1000.0;
+  printf("capture: %zu frames, %zu bytes, %.1f s\n", records.size(), bytes, duration);
+
+  ReplayResult best{};
+  for (uint32_t pass = 0; pass < repeat; pass++) {
+    ReplayResult result = replay(records, speed);
+    if (pass == 0 || result.seconds < best.seconds)
+      best = result;
+  }
+  printf("replay: best of %u, %.2f ms, %.2f us per frame, %.0fx real time, %u loop() passes\n", repeat,
+         best.seconds * 1000, best.seconds * 1e6 / records.size(), duration / best.seconds, best.loops);
+  printf("component: %u state changes, ends in %s, %u heights published, last %.1f cm\n", best.state_changes,
+         LOG_STR_ARG(desk_control_state_to_string(best.state)), best.height.publishes, best.height.state);
+  return best.state != DC_STATE_UNKNOWN && best.height.has_state() ? 0 : 1;
+}
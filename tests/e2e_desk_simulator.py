@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Runs the host build of the component against tools/desk_simulator.py on a pty.
+
+The host binary moves the desk and sets the timer, and checks that its own
+actions finished. The simulator's report then has to show the same end result
+on the controller's side.
+
+  e2e_desk_simulator.py BUILD_DIR/loctekmotion_desk_host
+"""
+
+import json
+import os
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+TOOLS = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "tools")
+TARGET_HEIGHT = 100
+# where the component stops the desk depends on when its key frames arrive, which a pty doesn't make exact
+HEIGHT_TOLERANCE = 0.5
+TIMER_MINUTES = 3
+TIMEOUT_S = 120
+
+
+def wait_for(condition, timeout):
+    end = time.monotonic() + timeout
+    while not condition():
+        if time.monotonic() > end:
+            return False
+        time.sleep(0.1)
+    return True
+
+
+def read_report(path):
+    if not os.path.exists(path):
+        return []
+    with open(path) as report:
+        return [json.loads(line) for line in report if line.strip()]
+
+
+def main():
+    host = sys.argv[1]
+    with tempfile.TemporaryDirectory() as directory:
+        link = os.path.join(directory, "desk")
+        report = os.path.join(directory, "report.jsonl")
+        # the display going off after 2 s also covers a timer set while it goes off
+        simulator = subprocess.Popen([sys.executable, os.path.join(TOOLS, "desk_simulator.py"), "--link", link,
+                                      "--report", report, "--sleep", "2", "--duration", str(TIMEOUT_S)])
+        try:
+            if not wait_for(lambda: os.path.exists(link), 5):
+                print("the simulator did not create its pty")
+                return 1
+            result = subprocess.run([host, link, "wake", "move_to_height", str(TARGET_HEIGHT),
+                                     "timer_set", str(TIMER_MINUTES)], timeout=TIMEOUT_S)
+            if result.returncode != 0:
+                print(f"the host build failed with {result.returncode}")
+                return 1
+            # the simulator reports a command once the desk has been idle for a second
+            done = wait_for(lambda: any(command["timer_minutes"] == TIMER_MINUTES
+                                        for command in read_report(report)), 5)
+        finally:
+            simulator.send_signal(signal.SIGINT)
+            simulator.wait(5)
+        commands = read_report(report)
+        if not done or abs(commands[-1]["height"] - TARGET_HEIGHT) > HEIGHT_TOLERANCE:
+            print(f"the controller did not end at {TARGET_HEIGHT} cm with a {TIMER_MINUTES} minute timer: {commands}")
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,66 @@
+#pragma once
+
+// Frames as the desk controller sends them, for the tests
+
+#include "key_frame.h"
+#include "segment_display.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace testing {
+
+inline std::vector<uint8_t> build_frame(uint8_t type, const std::vector<uint8_t> &payload) {
+  std::vector<uint8_t> frame{DATA_FRAME_START, (uint8_t) (payload.size() + DATA_FRAME_OVERHEAD), type};
+  for (uint8_t byte : payload)
+    frame.push_back(byte);
+  uint16_t crc = CRC16_INIT;
+  for (size_t i = 1; i < frame.size(); i++)
+    crc = crc16_update_bitwise(crc, frame[i]);
+  frame.push_back(crc >> 8);
+  frame.push_back(crc & 0xFF);
+  frame.push_back(DATA_FRAME_END);
+  return frame;
+}
+
+inline std::vector<uint8_t> display_frame(uint8_t segment1, uint8_t segment2, uint8_t segment3) {
+  return build_frame(DATA_TYPE_DISPLAY, {segment1, segment2, segment3});
+}
+
+const uint8_t DIGITS[] = {SEGMENT_SYMBOL_0, SEGMENT_SYMBOL_1, SEGMENT_SYMBOL_2, SEGMENT_SYMBOL_3, SEGMENT_SYMBOL_4,
+                          SEGMENT_SYMBOL_5, SEGMENT_SYMBOL_6, SEGMENT_SYMBOL_7, SEGMENT_SYMBOL_8, SEGMENT_SYMBOL_9};
+
+// the display showing a height, e.g. 75.3 or 110
+inline std::vector<uint8_t> height_frame(float height) {
+  if (height < 100) {
+    int tenths = (int) (height * 10 + 0.5f);
+    return display_frame(DIGITS[tenths / 100], DIGITS[tenths / 10 % 10] | SEGMENT_DOT_BIT, DIGITS[tenths % 10]);
+  }
+  int cm = (int) (height + 0.5f);
+  return display_frame(DIGITS[cm / 100], DIGITS[cm / 10 % 10], DIGITS[cm % 10]);
+}
+
+/**
+ * Puts the bytes into the reader the way the component does, re-parsing pending bytes after an error
+ * before the next new one. Returns the frames with a valid CRC.
+ */
+inline std::vector<std::vector<uint8_t>> read_frames(DataFrameReader &reader, const std::vector<uint8_t> &bytes) {
+  std::vector<std::vector<uint8_t>> frames;
+  auto put = [&](uint8_t byte) {
+    if (reader.put(byte))
+      frames.emplace_back(reader.frame.raw, reader.frame.raw + reader.frame.size());
+  };
+  for (uint8_t byte : bytes) {
+    put(byte);
+    uint8_t pending;
+    while (reader.pop_pending(&pending))
+      put(pending);
+  }
+  return frames;
+}
+
+}  // namespace testing
+}  // namespace loctekmotion_desk
+}  // namespace esphome
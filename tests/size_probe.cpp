@@ -0,0 +1,77 @@
+// A node with one desk, built with the feature defines of the library it links. Linked with unused
+// sections dropped like the firmware is, so tools/size_report.py --host can compare the code size of the
+// features. Prints the size of the desk object, or with --parts what it is made of, for the per-desk RAM
+// table in the README:
+//
+//   loctekmotion_desk_size_32bit_all_features --parts
+
+#include "desk.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace esphome;
+using namespace esphome::loctekmotion_desk;
+
+namespace {
+
+void print_part(const char *name, size_t bytes) { printf("%-56s %5zu\n", name, bytes); }
+
+void print_parts() {
+  // ESPHome's own objects are not the stubs' size, they are left out
+  size_t desk = sizeof(LoctekMotionComponent) - sizeof(Component) - sizeof(uart::UARTDevice);
+  size_t trace = 0;
+#ifdef USE_LOCTEKMOTION_DESK_TRANSITION_TRACE
+  trace = sizeof(TransitionTrace);
+#endif
+  struct {
+    const char *name;
+    size_t bytes;
+  } parts[] = {
+      {"receive buffer", sizeof(RingBuffer<RX_BUFFER_SIZE>)},
+      {"frame reader", sizeof(DataFrameReader)},
+      {"display, decoded display and state machine",
+       sizeof(SegmentDisplay) + sizeof(DecodedDisplay) + sizeof(DeskStateMachine) - trace},
+      {"send queue", sizeof(TxQueue<TX_QUEUE_SIZE>)},
+      {"frame handlers and logged frame types", sizeof(FrameDispatcher<FRAME_HANDLER_SLOTS>) + sizeof(FrameTypeSet)},
+#ifdef USE_LOCTEKMOTION_DESK_DIAGNOSTICS
+      {"diagnostics counters", sizeof(DeskDiagnostics)},
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_PRESET_HEIGHTS
+      {"preset heights", sizeof(PresetHeights)},
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_USAGE_STATISTICS
+      {"usage statistics", sizeof(UsageStatistics)},
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_FLIGHT_RECORDER
+      {"flight recorder, without its buffer", sizeof(FlightRecorder)},
+#endif
+#ifdef USE_LOCTEKMOTION_DESK_TRANSITION_TRACE
+      {"transition trace, without its records", trace},
+#endif
+  };
+  size_t rest = desk;
+  for (auto &part : parts) {
+    print_part(part.name, part.bytes);
+    rest -= part.bytes;
+  }
+  print_part("sensor pointers, callbacks, timer/move/motion state", rest);
+  print_part("desk", desk);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uart::UARTComponent uart;
+  Component *desk = new LoctekMotionComponent(&uart);
+  desk->setup();
+  desk->loop();
+  desk->dump_config();
+  desk->on_shutdown();
+  if (argc > 1 && strcmp(argv[1], "--parts") == 0) {
+    print_parts();
+  } else {
+    printf("%zu\n", sizeof(LoctekMotionComponent));
+  }
+  return 0;
+}
@@ -0,0 +1,238 @@
+// Host implementation of the stubbed ESPHome core: logger, clock, scheduler and preferences
+
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+#include "esphome/components/uart/uart.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace esphome {
+
+// logger
+
+static int log_level() {
+  static int level = [] {
+    const char *env = getenv("DESK_LOG_LEVEL");
+    return env != nullptr ? atoi(env) : ESPHOME_LOG_LEVEL_WARN;
+  }();
+  return level;
+}
+static int log_level_override = -1;
+
+void stub::set_log_level(int level) { log_level_override = level; }
+
+static const size_t MAX_WARNINGS = 64;
+static char warnings[MAX_WARNINGS][256];
+static size_t warnings_count = 0;
+
+size_t stub::warning_count() { return warnings_count < MAX_WARNINGS ? warnings_count : MAX_WARNINGS; }
+const char *stub::warning(size_t index) { return warnings[index]; }
+bool stub::has_warning(const char *text) {
+  for (size_t i = 0; i < stub::warning_count(); i++) {
+    if (strstr(warnings[i], text) != nullptr)
+      return true;
+  }
+  return false;
+}
+void stub::clear_warnings() { warnings_count = 0; }
+
+void esp_log_printf_(int level, const char *tag, int line, const char *format, ...) {
+  int max_level = log_level_override >= 0 ? log_level_override : log_level();
+  if (level > max_level && level > ESPHOME_LOG_LEVEL_WARN)
+    return;
+  // formatted in place, so that logging doesn't show up as heap allocations
+  char scratch[256];
+  char *message = level <= ESPHOME_LOG_LEVEL_WARN && warnings_count < MAX_WARNINGS ? warnings[warnings_count++] : scratch;
+  va_list args;
+  va_start(args, format);
+  vsnprintf(message, sizeof(scratch), format, args);
+  va_end(args);
+  if (level <= max_level) {
+    static const char LETTERS[] = "-EWICDVV";
+    fprintf(stderr, "[%c][%s:%03d]: %s\n", LETTERS[level], tag, line, message);
+  }
+}
+
+// clock
+
+static uint64_t now_us = 0;
+static bool system_clock = false;
+
+static uint64_t clock_us() {
+  if (!system_clock)
+    return now_us;
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static uint32_t millis_call_count = 0;
+
+uint32_t millis() {
+  millis_call_count++;
+  return (uint32_t) (clock_us() / 1000);
+}
+uint32_t stub::millis_calls() { return millis_call_count; }
+uint32_t micros() { return (uint32_t) clock_us(); }
+
+void stub::set_time(uint32_t ms) { now_us = (uint64_t) ms * 1000; }
+void stub::advance_time(uint32_t ms) { now_us += (uint64_t) ms * 1000; }
+void stub::use_system_clock() { system_clock = true; }
+
+// scheduler, items are keyed by component and name like ESPHome's
+
+namespace setup_priority {
+const float BUS = 1000.0f;
+const float HARDWARE = 800.0f;
+const float DATA = 600.0f;
+const float LATE = -100.0f;
+}  // namespace setup_priority
+
+struct SchedulerItem {
+  Component *component;
+  std::string name;
+  bool interval;
+  uint32_t period;
+  uint32_t next;
+  bool removed;
+  std::function<void()> callback;
+};
+
+static std::vector<SchedulerItem> &scheduler_items() {
+  static std::vector<SchedulerItem> items;
+  return items;
+}
+
+// earliest time an item may be due, so runs with nothing due return right away like ESPHome's, which only looks at
+// the top of its heap
+static uint32_t next_due = 0;
+static uint32_t scheduled_item_count = 0;
+
+static bool cancel_item(Component *component, const std::string &name, bool interval) {
+  if (name.empty())
+    return false;
+  bool found = false;
+  for (auto &item : scheduler_items()) {
+    if (!item.removed && item.component == component && item.interval == interval && item.name == name) {
+      item.removed = true;
+      found = true;
+    }
+  }
+  return found;
+}
+
+static void add_item(Component *component, const std::string &name, bool interval, uint32_t period,
+                     std::function<void()> &&callback) {
+  cancel_item(component, name, interval);
+  scheduled_item_count++;
+  uint32_t next = (uint32_t) (clock_us() / 1000) + period;
+  scheduler_items().push_back({component, name, interval, period, next, false, std::move(callback)});
+  if (scheduler_items().size() == 1 || (int32_t) (next - next_due) < 0)
+    next_due = next;
+}
+
+Component::~Component() {
+  for (auto &item : scheduler_items()) {
+    if (item.component == this)
+      item.removed = true;
+  }
+}
+
+void Component::set_interval(const std::string &name, uint32_t interval, std::function<void()> &&f) {
+  add_item(this, name, true, interval, std::move(f));
+}
+bool Component::cancel_interval(const std::string &name) { return cancel_item(this, name, true); }
+void Component::set_timeout(const std::string &name, uint32_t timeout, std::function<void()> &&f) {
+  add_item(this, name, false, timeout, std::move(f));
+}
+bool Component::cancel_timeout(const std::string &name) { return cancel_item(this, name, false); }
+
+void stub::run_scheduler() {
+  auto &items = scheduler_items();
+  uint32_t now = (uint32_t) (clock_us() / 1000);
+  if (items.empty() || (int32_t) (now - next_due) < 0)
+    return;
+  // callbacks may add items, so index and copy instead of holding references
+  for (size_t i = 0; i < items.size(); i++) {
+    if (items[i].removed || (int32_t) (now - items[i].next) < 0)
+      continue;
+    auto callback = items[i].callback;
+    if (items[i].interval) {
+      items[i].next += items[i].period;
+    } else {
+      items[i].removed = true;
+    }
+    callback();
+  }
+  for (size_t i = 0; i < items.size();) {
+    if (items[i].removed) {
+      items.erase(items.begin() + i);
+    } else {
+      i++;
+    }
+  }
+  for (size_t i = 0; i < items.size(); i++) {
+    if (i == 0 || (int32_t) (items[i].next - next_due) < 0)
+      next_due = items[i].next;
+  }
+}
+
+uint32_t stub::scheduled_count() { return scheduled_item_count; }
+
+size_t stub::scheduler_item_count() {
+  size_t count = 0;
+  for (auto &item : scheduler_items()) {
+    if (!item.removed)
+      count++;
+  }
+  return count;
+}
+
+// preferences
+
+static std::map<uint32_t, std::vector<uint8_t>> &preference_store() {
+  static std::map<uint32_t, std::vector<uint8_t>> store;
+  return store;
+}
+static uint32_t preference_write_count = 0;
+
+bool ESPPreferenceObject::save_(const void *data, size_t size) {
+  auto bytes = static_cast<const uint8_t *>(data);
+  preference_store()[this->key_].assign(bytes, bytes + size);
+  preference_write_count++;
+  return true;
+}
+
+bool ESPPreferenceObject::load_(void *data, size_t size) {
+  auto it = preference_store().find(this->key_);
+  if (it == preference_store().end() || it->second.size() != size)
+    return false;
+  memcpy(data, it->second.data(), size);
+  return true;
+}
+
+static ESPPreferences preferences;
+ESPPreferences *global_preferences = &preferences;
+
+uint32_t stub::preference_writes() { return preference_write_count; }
+void stub::clear_preferences() { preference_store().clear(); }
+
+// UART
+
+bool uart::UARTComponent::read_array(uint8_t *data, size_t len) {
+  if (this->rx_.size() < len)
+    return false;
+  for (size_t i = 0; i < len; i++) {
+    data[i] = this->rx_.front();
+    this->rx_.pop_front();
+  }
+  return true;
+}
+
+}  // namespace esphome
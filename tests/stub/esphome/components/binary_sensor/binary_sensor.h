@@ -0,0 +1,27 @@
+#pragma once
+
+// Host stand-in for ESPHome's binary sensor, records what was published
+
+#include <cstdint>
+
+#define LOG_BINARY_SENSOR(prefix, type, obj) \
+  if ((obj) != nullptr) { \
+    ESP_LOGCONFIG(TAG, "%s%s", prefix, type); \
+  }
+
+namespace esphome {
+namespace binary_sensor {
+
+class BinarySensor {
+ public:
+  void publish_state(bool state) {
+    this->state = state;
+    this->publishes++;
+  }
+
+  bool state{false};
+  uint32_t publishes{0};  // host only
+};
+
+}  // namespace binary_sensor
+}  // namespace esphome
@@ -0,0 +1,19 @@
+#pragma once
+
+// Host stand-in for ESPHome's button
+
+namespace esphome {
+namespace button {
+
+class Button {
+ public:
+  virtual ~Button() = default;
+
+  void press() { this->press_action(); }
+
+ protected:
+  virtual void press_action() = 0;
+};
+
+}  // namespace button
+}  // namespace esphome
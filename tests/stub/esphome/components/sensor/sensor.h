@@ -0,0 +1,28 @@
+#pragma once
+
+// Host stand-in for ESPHome's sensor, records what was published
+
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace sensor {
+
+class Sensor {
+ public:
+  void publish_state(float state) {
+    this->state = state;
+    this->has_state_ = true;
+    this->publishes++;
+  }
+  bool has_state() const { return this->has_state_; }
+
+  float state{NAN};
+  uint32_t publishes{0};  // host only
+
+ protected:
+  bool has_state_{false};
+};
+
+}  // namespace sensor
+}  // namespace esphome
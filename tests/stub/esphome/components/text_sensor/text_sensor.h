@@ -0,0 +1,23 @@
+#pragma once
+
+// Host stand-in for ESPHome's text sensor, records what was published
+
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace text_sensor {
+
+class TextSensor {
+ public:
+  void publish_state(const std::string &state) {
+    this->state = state;
+    this->publishes++;
+  }
+
+  std::string state;
+  uint32_t publishes{0};  // host only
+};
+
+}  // namespace text_sensor
+}  // namespace esphome
@@ -0,0 +1,56 @@
+#pragma once
+
+// Host stand-in for ESPHome's UART. The default bus is a pair of in-memory byte queues the test feeds
+// and drains; a host binary can override the virtual methods to talk to a real file descriptor
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace esphome {
+namespace uart {
+
+class UARTComponent {
+ public:
+  virtual ~UARTComponent() = default;
+
+  virtual void write_array(const uint8_t *data, size_t len) { this->tx_.insert(this->tx_.end(), data, data + len); }
+  virtual bool read_array(uint8_t *data, size_t len);
+  virtual int available() { return (int) this->rx_.size(); }
+
+  uint32_t get_baud_rate() const { return this->baud_rate_; }
+  void set_baud_rate(uint32_t baud_rate) { this->baud_rate_ = baud_rate; }
+
+  // host only: bytes the desk controller sends, and bytes the component has written
+  void inject(const uint8_t *data, size_t len) { this->rx_.insert(this->rx_.end(), data, data + len); }
+  void inject(const std::vector<uint8_t> &data) { this->inject(data.data(), data.size()); }
+  std::vector<uint8_t> &written() { return this->tx_; }
+
+ protected:
+  uint32_t baud_rate_{9600};
+  std::deque<uint8_t> rx_;
+  std::vector<uint8_t> tx_;
+};
+
+class UARTDevice {
+ public:
+  UARTDevice() = default;
+  UARTDevice(UARTComponent *parent) : parent_(parent) {}
+
+  void set_uart_parent(UARTComponent *parent) { this->parent_ = parent; }
+
+  void write_array(const uint8_t *data, size_t len) { this->parent_->write_array(data, len); }
+  void write_array(const std::vector<uint8_t> &data) { this->parent_->write_array(data.data(), data.size()); }
+  bool read_byte(uint8_t *data) { return this->parent_->read_array(data, 1); }
+  bool read_array(uint8_t *data, size_t len) { return this->parent_->read_array(data, len); }
+  int available() { return this->parent_->available(); }
+
+  void check_uart_settings([[maybe_unused]] uint32_t baud_rate) {}
+
+ protected:
+  UARTComponent *parent_{nullptr};
+};
+
+}  // namespace uart
+}  // namespace esphome
@@ -0,0 +1,55 @@
+#pragma once
+
+// Host stand-in for ESPHome's automations. A trigger calls back into the test instead of running actions
+
+#include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+
+#include <functional>
+#include <utility>
+
+namespace esphome {
+
+template<typename T, typename... X> class TemplatableValue {
+ public:
+  TemplatableValue() = default;
+  TemplatableValue(T value) : value_(value) {}
+
+  T value(X... x) { return this->value_; }
+  bool has_value() const { return true; }
+
+ protected:
+  T value_{};
+};
+
+#define TEMPLATABLE_VALUE_(type, name) \
+ protected: \
+  TemplatableValue<type, Ts...> name##_{}; \
+\
+ public: \
+  template<typename V> void set_##name(V name) { this->name##_ = name; }
+
+#define TEMPLATABLE_VALUE(type, name) TEMPLATABLE_VALUE_(type, name)
+
+template<typename... Ts> class Trigger {
+ public:
+  void trigger(Ts... x) {
+    if (this->on_trigger_)
+      this->on_trigger_(x...);
+  }
+  void stop_action() {}
+
+  // host only: what the automation would run
+  void set_on_trigger(std::function<void(Ts...)> &&on_trigger) { this->on_trigger_ = std::move(on_trigger); }
+
+ protected:
+  std::function<void(Ts...)> on_trigger_;
+};
+
+template<typename... Ts> class Action {
+ public:
+  virtual ~Action() = default;
+  virtual void play(Ts... x) = 0;
+};
+
+}  // namespace esphome
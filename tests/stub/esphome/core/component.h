@@ -0,0 +1,55 @@
+#pragma once
+
+// Host stand-in for ESPHome's Component and its scheduler. Timeouts and intervals are kept in one
+// list for all components and run by stub::run_scheduler(), see tests/stub/esphome.cpp
+
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace esphome {
+
+namespace setup_priority {
+extern const float BUS;
+extern const float DATA;
+extern const float HARDWARE;
+extern const float LATE;
+}  // namespace setup_priority
+
+class Component {
+ public:
+  virtual ~Component();
+
+  virtual void setup() {}
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual float get_setup_priority() const { return setup_priority::DATA; }
+  virtual void on_shutdown() {}
+
+  void mark_failed() { this->failed_ = true; }
+  bool is_failed() const { return this->failed_; }
+
+ protected:
+  void set_interval(const std::string &name, uint32_t interval, std::function<void()> &&f);
+  void set_interval(uint32_t interval, std::function<void()> &&f) { this->set_interval("", interval, std::move(f)); }
+  bool cancel_interval(const std::string &name);
+  void set_timeout(const std::string &name, uint32_t timeout, std::function<void()> &&f);
+  void set_timeout(uint32_t timeout, std::function<void()> &&f) { this->set_timeout("", timeout, std::move(f)); }
+  bool cancel_timeout(const std::string &name);
+
+  bool failed_{false};
+};
+
+namespace stub {
+// runs the timeouts and intervals that are due
+void run_scheduler();
+// scheduler items that exist, to check that nothing is created on every frame
+size_t scheduler_item_count();
+// set_interval and set_timeout calls so far, including ones that replaced an item of the same name
+uint32_t scheduled_count();
+}  // namespace stub
+
+}  // namespace esphome
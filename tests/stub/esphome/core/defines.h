@@ -0,0 +1,4 @@
+#pragma once
+
+// Generated by ESPHome from the configuration. The host build passes the USE_LOCTEKMOTION_DESK_*
+// defines on the command line instead, see CMakeLists.txt
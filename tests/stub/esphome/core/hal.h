@@ -0,0 +1,38 @@
+#pragma once
+
+// Host stand-in for ESPHome's HAL. The clock is simulated unless the system clock is selected,
+// see tests/stub/esphome.cpp
+
+#include <cstdint>
+
+#define PROGMEM
+
+namespace esphome {
+
+uint32_t millis();
+uint32_t micros();
+
+namespace stub {
+// flash reads, which cost far more on an ESP8266 than a RAM read. Only counted, since the host has no flash
+inline uint32_t progmem_read_count = 0;
+}  // namespace stub
+
+inline uint8_t progmem_read_byte(const uint8_t *addr) {
+  stub::progmem_read_count++;
+  return *addr;
+}
+inline uint16_t progmem_read_uint16(const uint16_t *addr) {
+  stub::progmem_read_count++;
+  return *addr;
+}
+
+namespace stub {
+void set_time(uint32_t ms);
+void advance_time(uint32_t ms);
+// millis() and micros() follow the steady clock from now on, for runs against a real serial port
+void use_system_clock();
+// how often the component read the clock, a call that costs far more on a device than on the host
+uint32_t millis_calls();
+}  // namespace stub
+
+}  // namespace esphome
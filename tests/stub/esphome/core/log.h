@@ -0,0 +1,45 @@
+#pragma once
+
+// Host stand-in for ESPHome's logger. Same macros, printed by esp_log_printf_() in tests/stub/esphome.cpp
+
+#include <cstdarg>
+#include <cstddef>
+
+#define ESPHOME_LOG_LEVEL_NONE 0
+#define ESPHOME_LOG_LEVEL_ERROR 1
+#define ESPHOME_LOG_LEVEL_WARN 2
+#define ESPHOME_LOG_LEVEL_INFO 3
+#define ESPHOME_LOG_LEVEL_CONFIG 4
+#define ESPHOME_LOG_LEVEL_DEBUG 5
+#define ESPHOME_LOG_LEVEL_VERBOSE 6
+#define ESPHOME_LOG_LEVEL_VERY_VERBOSE 7
+
+namespace esphome {
+
+struct LogString;
+
+void esp_log_printf_(int level, const char *tag, int line, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+namespace stub {
+// messages above this level are dropped. ESPHOME_LOG_LEVEL_WARN unless set, e.g. from the DESK_LOG_LEVEL environment variable
+void set_log_level(int level);
+// warnings and errors are also kept, without allocating, for the tests to check
+size_t warning_count();
+const char *warning(size_t index);
+bool has_warning(const char *text);  // a kept warning contains the text
+void clear_warnings();
+}  // namespace stub
+
+}  // namespace esphome
+
+#define LOG_STR(s) (reinterpret_cast<const esphome::LogString *>(s))
+#define LOG_STR_ARG(s) (reinterpret_cast<const char *>(s))
+
+#define ESP_LOGE(tag, ...) esphome::esp_log_printf_(ESPHOME_LOG_LEVEL_ERROR, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) esphome::esp_log_printf_(ESPHOME_LOG_LEVEL_WARN, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) esphome::esp_log_printf_(ESPHOME_LOG_LEVEL_INFO, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) esphome::esp_log_printf_(ESPHOME_LOG_LEVEL_CONFIG, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) esphome::esp_log_printf_(ESPHOME_LOG_LEVEL_DEBUG, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) esphome::esp_log_printf_(ESPHOME_LOG_LEVEL_VERBOSE, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGVV(tag, ...) esphome::esp_log_printf_(ESPHOME_LOG_LEVEL_VERY_VERBOSE, tag, __LINE__, __VA_ARGS__)
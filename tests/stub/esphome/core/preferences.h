@@ -0,0 +1,43 @@
+#pragma once
+
+// Host stand-in for ESPHome's preferences, kept in memory for the lifetime of the process
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+
+class ESPPreferenceObject {
+ public:
+  ESPPreferenceObject() = default;
+  explicit ESPPreferenceObject(uint32_t key) : key_(key), valid_(true) {}
+
+  template<typename T> bool save(const T *src) { return this->valid_ && this->save_(src, sizeof(T)); }
+  template<typename T> bool load(T *dest) { return this->valid_ && this->load_(dest, sizeof(T)); }
+
+ protected:
+  bool save_(const void *data, size_t size);
+  bool load_(void *data, size_t size);
+
+  uint32_t key_{0};
+  bool valid_{false};
+};
+
+class ESPPreferences {
+ public:
+  template<typename T> ESPPreferenceObject make_preference(uint32_t type, bool in_flash) {
+    return ESPPreferenceObject(type);
+  }
+  template<typename T> ESPPreferenceObject make_preference(uint32_t type) { return ESPPreferenceObject(type); }
+  bool sync() { return true; }
+};
+
+extern ESPPreferences *global_preferences;
+
+namespace stub {
+// number of preference writes so far, to check that flash is spared
+uint32_t preference_writes();
+void clear_preferences();
+}  // namespace stub
+
+}  // namespace esphome
@@ -0,0 +1,98 @@
+// Built with USE_LOCTEKMOTION_DESK_ALLOCATION_COUNTER, so the component's operator new and delete
+// replace the library's for the whole test binary
+
+#include "automation.h"
+#include "desk.h"
+#include "frames.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace {
+
+TEST(AllocationCounter, EveryFormAllocatesAndFrees) {
+  auto *single = new int(1);
+  delete single;
+  auto *array = new int[16]();
+  delete[] array;
+  auto *nothrow_single = new (std::nothrow) int(2);
+  ASSERT_NE(nothrow_single, nullptr);
+  delete nothrow_single;
+  auto *nothrow_array = new (std::nothrow) int[16]();
+  ASSERT_NE(nothrow_array, nullptr);
+  delete[] nothrow_array;
+  void *raw = ::operator new(32);
+  ::operator delete(raw, 32);
+  raw = ::operator new[](32);
+  ::operator delete[](raw, 32);
+  raw = ::operator new(0);
+  EXPECT_NE(raw, nullptr);
+  ::operator delete(raw);
+}
+
+TEST(AllocationCounter, FailedAllocationThrows) {
+  EXPECT_THROW((void) ::operator new(SIZE_MAX), std::bad_alloc);
+  EXPECT_THROW((void) ::operator new[](SIZE_MAX), std::bad_alloc);
+  EXPECT_EQ(::operator new(SIZE_MAX, std::nothrow), nullptr);
+  EXPECT_EQ(::operator new[](SIZE_MAX, std::nothrow), nullptr);
+}
+
+TEST(AllocationCounter, ReceivePathDoesNotAllocate) {
+  uart::UARTComponent uart;
+  LoctekMotionComponent desk(&uart);
+  desk.setup();
+  stub::clear_warnings();
+
+  for (float height : {75.0f, 75.0f, 75.4f, 75.9f, 76.3f, 76.3f, 76.3f}) {
+    uart.inject(testing::height_frame(height));
+    desk.loop();
+    stub::advance_time(108);
+  }
+
+  EXPECT_FALSE(stub::has_warning("heap allocations"));
+}
+
+TEST(AllocationCounter, OnFrameTriggerDoesNotAllocate) {
+  uart::UARTComponent uart;
+  LoctekMotionComponent desk(&uart);
+  LoctekMotionOnFrameTrigger trigger(&desk, 0x33);
+  uint8_t payload[4]{};
+  size_t payload_size = 0;
+  trigger.set_on_trigger([&](FramePayload x) {
+    payload_size = x.size();
+    std::copy(x.begin(), x.end(), payload);
+  });
+  desk.setup();
+  stub::clear_warnings();
+
+  uart.inject(testing::build_frame(0x33, {0x01, 0x02, 0x03}));
+  desk.loop();
+  EXPECT_EQ(payload_size, 3u);
+  EXPECT_EQ(payload[2], 0x03);
+  EXPECT_FALSE(stub::has_warning("heap allocations"));
+}
+
+TEST(AllocationCounter, WarnsAboutAllocationInLoop) {
+  uart::UARTComponent uart;
+  LoctekMotionComponent desk(&uart);
+  static int *leaked = nullptr;
+  desk.add_frame_handler(0x33, [](const DataFrame &) {
+    delete leaked;
+    leaked = new int(0);
+  });
+  desk.setup();
+  stub::clear_warnings();
+
+  uart.inject(testing::build_frame(0x33, {0x00}));
+  desk.loop();
+  EXPECT_TRUE(stub::has_warning("1 heap allocations in loop()"));
+}
+
+}  // namespace
+}  // namespace loctekmotion_desk
+}  // namespace esphome
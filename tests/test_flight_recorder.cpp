@@ -0,0 +1,51 @@
+#include "flight_recorder.h"
+#include "frames.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace {
+
+DataFrame to_frame(const std::vector<uint8_t> &bytes) {
+  DataFrame frame{};
+  memcpy(frame.raw, bytes.data(), bytes.size());
+  return frame;
+}
+
+TEST(FlightRecorder, ZeroCapacityStaysDisabled) {
+  FlightRecorder recorder;
+  recorder.init(0);
+  EXPECT_EQ(recorder.capacity(), 0u);
+  recorder.record(0, to_frame(testing::height_frame(75)));
+  EXPECT_EQ(recorder.size(), 0u);
+  stub::clear_warnings();
+  recorder.dump();
+  EXPECT_TRUE(stub::has_warning("not enabled"));
+}
+
+TEST(FlightRecorder, StoresRepeatsAsDeltaOnly) {
+  FlightRecorder recorder;
+  recorder.init(64);
+  recorder.record(0, to_frame(testing::height_frame(75)));
+  EXPECT_EQ(recorder.size(), 1u + 7u);  // varint and the frame from its length byte up to the CRC
+  recorder.record(108, to_frame(testing::height_frame(75)));
+  EXPECT_EQ(recorder.size(), 8u + 2u);  // 108 << 1 | 1 takes two varint bytes
+}
+
+TEST(FlightRecorder, DropsOldestRecordsWhenFull) {
+  FlightRecorder recorder;
+  recorder.init(20);
+  recorder.record(0, to_frame(testing::height_frame(75)));
+  recorder.record(10, to_frame(testing::height_frame(76)));
+  EXPECT_EQ(recorder.dropped_records(), 0u);
+  recorder.record(20, to_frame(testing::height_frame(77)));
+  EXPECT_EQ(recorder.dropped_records(), 1u);
+  EXPECT_EQ(recorder.size(), 16u);
+}
+
+}  // namespace
+}  // namespace loctekmotion_desk
+}  // namespace esphome
@@ -0,0 +1,118 @@
+#include "desk.h"
+#include "frame_dispatch.h"
+#include "frames.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace {
+
+DataFrame frame_of_type(uint8_t type) {
+  DataFrame frame{};
+  auto bytes = testing::build_frame(type, {0x00});
+  memcpy(frame.raw, bytes.data(), bytes.size());
+  return frame;
+}
+
+TEST(FrameDispatcher, CallsHandlerOfType) {
+  FrameDispatcher<8> dispatcher;
+  int display = 0, beep = 0;
+  EXPECT_TRUE(dispatcher.add(DATA_TYPE_DISPLAY, [&](const DataFrame &) { display++; }));
+  EXPECT_TRUE(dispatcher.add(DATA_TYPE_BEEP, [&](const DataFrame &) { beep++; }));
+  EXPECT_TRUE(dispatcher.dispatch(frame_of_type(DATA_TYPE_DISPLAY)));
+  EXPECT_TRUE(dispatcher.dispatch(frame_of_type(DATA_TYPE_DISPLAY)));
+  EXPECT_TRUE(dispatcher.dispatch(frame_of_type(DATA_TYPE_BEEP)));
+  EXPECT_FALSE(dispatcher.dispatch(frame_of_type(0x33)));
+  EXPECT_EQ(display, 2);
+  EXPECT_EQ(beep, 1);
+}
+
+TEST(FrameDispatcher, HandlesCollidingTypes) {
+  FrameDispatcher<4> dispatcher;
+  uint8_t last = 0;
+  // 0x01, 0x05 and 0x09 share their low bits
+  for (uint8_t type : {0x01, 0x05, 0x09})
+    EXPECT_TRUE(dispatcher.add(type, [&last, type](const DataFrame &) { last = type; }));
+  for (uint8_t type : {0x09, 0x01, 0x05}) {
+    EXPECT_TRUE(dispatcher.dispatch(frame_of_type(type)));
+    EXPECT_EQ(last, type);
+  }
+  EXPECT_FALSE(dispatcher.dispatch(frame_of_type(0x0D)));
+}
+
+TEST(FrameDispatcher, RejectsWhenFull) {
+  FrameDispatcher<2> dispatcher;
+  EXPECT_TRUE(dispatcher.add(0x01, nullptr));
+  EXPECT_TRUE(dispatcher.add(0x02, nullptr));
+  EXPECT_FALSE(dispatcher.add(0x03, nullptr));
+  EXPECT_FALSE(dispatcher.dispatch(frame_of_type(0x03)));
+}
+
+TEST(FrameDispatcher, KnownTypeWithoutHandlerIsHandled) {
+  FrameDispatcher<8> dispatcher;
+  dispatcher.add(DATA_TYPE_UNKNOWN_11, nullptr);
+  EXPECT_TRUE(dispatcher.dispatch(frame_of_type(DATA_TYPE_UNKNOWN_11)));
+}
+
+TEST(FrameDispatcher, HandlerReplacesDefault) {
+  FrameDispatcher<8> dispatcher;
+  int defaults = 0, handled = 0;
+  EXPECT_TRUE(dispatcher.add_default(DATA_TYPE_BEEP, [&](const DataFrame &) { defaults++; }));
+  EXPECT_TRUE(dispatcher.add_default(DATA_TYPE_UNKNOWN_11, nullptr));
+  EXPECT_FALSE(dispatcher.add_default(DATA_TYPE_BEEP, nullptr));
+  EXPECT_TRUE(dispatcher.add(DATA_TYPE_BEEP, [&](const DataFrame &) { handled++; }));
+  EXPECT_TRUE(dispatcher.add(DATA_TYPE_UNKNOWN_11, [&](const DataFrame &) { handled++; }));
+  EXPECT_TRUE(dispatcher.dispatch(frame_of_type(DATA_TYPE_BEEP)));
+  EXPECT_TRUE(dispatcher.dispatch(frame_of_type(DATA_TYPE_UNKNOWN_11)));
+  EXPECT_EQ(defaults, 0);
+  EXPECT_EQ(handled, 2);
+  // only the default is replaced, not the handler that replaced it
+  EXPECT_FALSE(dispatcher.add(DATA_TYPE_BEEP, nullptr));
+  EXPECT_FALSE(dispatcher.add_default(DATA_TYPE_BEEP, nullptr));
+}
+
+TEST(FrameDispatcher, ReplacingDefaultTakesNoSlot) {
+  FrameDispatcher<2> dispatcher;
+  EXPECT_TRUE(dispatcher.add_default(0x01, nullptr));
+  EXPECT_TRUE(dispatcher.add(0x02, nullptr));
+  EXPECT_TRUE(dispatcher.add(0x01, nullptr));
+  EXPECT_FALSE(dispatcher.add(0x03, nullptr));
+}
+
+TEST(FrameHandlers, ReplaceTheComponentDefaultsButNotTheDisplay) {
+  uart::UARTComponent uart;
+  LoctekMotionComponent desk(&uart);
+  stub::clear_warnings();
+  int beeps = 0, unknown_11 = 0;
+  EXPECT_TRUE(desk.add_frame_handler(DATA_TYPE_BEEP, [&](const DataFrame &) { beeps++; }));
+  EXPECT_TRUE(desk.add_frame_handler(DATA_TYPE_UNKNOWN_11, [&](const DataFrame &) { unknown_11++; }));
+  EXPECT_FALSE(desk.add_frame_handler(DATA_TYPE_DISPLAY, nullptr));
+  EXPECT_TRUE(stub::has_warning("Frame type 0x12 already has a handler"));
+  // 4 slots left for new types
+  for (uint8_t type : {0x81, 0x82, 0x83, 0x84})
+    EXPECT_TRUE(desk.add_frame_handler(type, nullptr)) << (int) type;
+  EXPECT_FALSE(desk.add_frame_handler(0x85, nullptr));
+
+  desk.setup();
+  uart.inject(testing::build_frame(DATA_TYPE_BEEP, {}));
+  uart.inject(testing::build_frame(DATA_TYPE_UNKNOWN_11, {0x01}));
+  desk.loop();
+  EXPECT_EQ(beeps, 1);
+  EXPECT_EQ(unknown_11, 1);
+}
+
+TEST(FrameTypeSet, InsertsOnce) {
+  FrameTypeSet set;
+  EXPECT_TRUE(set.insert(0x00));
+  EXPECT_TRUE(set.insert(0xFF));
+  EXPECT_FALSE(set.insert(0xFF));
+  EXPECT_TRUE(set.insert(0x07));
+  EXPECT_FALSE(set.insert(0x00));
+}
+
+}  // namespace
+}  // namespace loctekmotion_desk
+}  // namespace esphome
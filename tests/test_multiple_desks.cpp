@@ -0,0 +1,80 @@
+// Features are compiled in for every desk of a node as soon as one desk uses them. A desk without the
+// sensors or buffer sizes of a feature must not run it
+
+#include "desk_model.h"
+
+#include <gtest/gtest.h>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace {
+
+using testing::DeskModelConfig;
+using testing::DeskSimulation;
+
+const uint32_t USAGE_SAVE_INTERVAL_MS = 60000;
+
+DeskModelConfig awake() {
+  DeskModelConfig config;
+  config.sleep_ms = 24 * 3600 * 1000;  // keeps showing the height
+  return config;
+}
+
+class MultipleDesks : public ::testing::Test {
+ protected:
+  // the controller starts off, a key press wakes it up to show the height
+  void wake_up() {
+    ASSERT_TRUE(sim.run_until([&] { return sim.desk.current_state() == DC_STATE_OFF; }, 2000));
+    sim.desk.press_keys(KEY_MEMORY, TX_PRIORITY_MOTION);
+    ASSERT_TRUE(sim.run_until([&] { return sim.desk.current_state() == DC_STATE_HEIGHT; }, 2000));
+  }
+
+  void SetUp() override {
+    stub::clear_preferences();
+    stub::clear_warnings();
+    sim.desk.set_usage_save_interval(USAGE_SAVE_INTERVAL_MS);
+  }
+
+  DeskSimulation sim{awake()};
+};
+
+TEST_F(MultipleDesks, DeskWithTheSensorsRunsTheFeatures) {
+  sensor::Sensor sitting_time, frame_rate, preset1_height;
+  sim.desk.set_sitting_time_sensor(&sitting_time);
+  sim.desk.set_frame_rate_sensor(&frame_rate);
+  sim.desk.set_preset_height_sensor(1, &preset1_height);
+  sim.desk.set_flight_recorder_size(256);
+  uint32_t writes = stub::preference_writes();
+  sim.setup();
+  EXPECT_EQ(stub::scheduler_item_count(), 3u);  // diagnostics, usage publish and usage save
+  wake_up();
+
+  sim.run(5 * USAGE_SAVE_INTERVAL_MS);
+  EXPECT_GE(stub::preference_writes() - writes, 4u);
+  EXPECT_GT(sitting_time.state, 0);
+  EXPECT_GT(frame_rate.state, 0);
+
+  sim.desk.dump_flight_recorder();
+  EXPECT_FALSE(stub::has_warning("not enabled"));
+}
+
+TEST_F(MultipleDesks, DeskWithoutTheSensorsRunsNothing) {
+  uint32_t writes = stub::preference_writes();
+  sim.setup();
+  EXPECT_EQ(stub::scheduler_item_count(), 0u);
+  wake_up();
+
+  sim.run(5 * USAGE_SAVE_INTERVAL_MS);
+  sim.desk.press_keys(KEY_PRESET2, TX_PRIORITY_MOTION);
+  sim.run(30000);
+  sim.desk.on_shutdown();
+  EXPECT_EQ(stub::preference_writes() - writes, 0u);
+  EXPECT_EQ(stub::scheduler_item_count(), 0u);
+
+  sim.desk.dump_flight_recorder();
+  EXPECT_TRUE(stub::has_warning("Flight recorder is not enabled"));
+}
+
+}  // namespace
+}  // namespace loctekmotion_desk
+}  // namespace esphome
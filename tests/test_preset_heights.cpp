@@ -0,0 +1,85 @@
+// Learning the preset heights against the controller model, from the presets pressed through the component
+
+#include "desk_model.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace {
+
+using testing::DeskModelConfig;
+using testing::DeskSimulation;
+
+DeskModelConfig awake() {
+  DeskModelConfig config;
+  config.sleep_ms = 24 * 3600 * 1000;  // keeps showing the height after the moves
+  return config;
+}
+
+class PresetHeights : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    stub::clear_preferences();
+    sim.desk.set_preset_height_sensor(1, &preset1_height);
+    sim.desk.set_preset_height_sensor(2, &preset2_height);
+    sim.desk.set_eta_sensor(&eta);
+    sim.setup();
+    // the controller starts off, a key press wakes it up to show the height
+    ASSERT_TRUE(sim.run_until([&] { return sim.desk.current_state() == DC_STATE_OFF; }, 2000));
+    sim.desk.press_keys(KEY_MEMORY, TX_PRIORITY_MOTION);
+    ASSERT_TRUE(sim.run_until([&] { return sim.desk.current_state() == DC_STATE_HEIGHT; }, 2000));
+  }
+
+  DeskSimulation sim{awake()};
+  sensor::Sensor preset1_height, preset2_height, eta;
+};
+
+TEST_F(PresetHeights, LearnsThePresetTheDeskMovedTo) {
+  sim.desk.press_keys(KEY_PRESET2, TX_PRIORITY_MOTION);
+  ASSERT_TRUE(sim.run_until([&] { return !std::isnan(sim.desk.get_preset_height(2)); }, 30000));
+  EXPECT_FLOAT_EQ(sim.desk.get_preset_height(2), sim.model.presets[1]);
+  EXPECT_FLOAT_EQ(preset2_height.state, sim.model.presets[1]);
+}
+
+TEST_F(PresetHeights, EtaIsKnownForALearnedPreset) {
+  bool eta_known = false;
+  sim.desk.press_keys(KEY_PRESET2, TX_PRIORITY_MOTION);
+  ASSERT_TRUE(sim.run_until([&] {
+    eta_known |= eta.has_state() && eta.state > 0;
+    return !std::isnan(sim.desk.get_preset_height(2));
+  }, 30000));
+  EXPECT_FALSE(eta_known);  // not learned yet while it moved there
+
+  bool moved = false;
+  sim.desk.add_on_move_to_height_done_callback([&](float height) { moved = true; });
+  sim.desk.move_to_height(80);
+  ASSERT_TRUE(sim.run_until([&] { return moved; }, 30000));
+  uint32_t publishes = eta.publishes;
+  sim.desk.press_keys(KEY_PRESET2, TX_PRIORITY_MOTION);
+  EXPECT_TRUE(sim.run_until([&] { return eta.publishes != publishes && eta.state > 0; }, 5000));
+}
+
+TEST_F(PresetHeights, SaveThatIsNotTakenLearnsNothing) {
+  // a move learned first, so a learning run has already ended after the desk moved
+  sim.desk.press_keys(KEY_PRESET2, TX_PRIORITY_MOTION);
+  ASSERT_TRUE(sim.run_until([&] { return !std::isnan(sim.desk.get_preset_height(2)); }, 30000));
+
+  sim.desk.press_keys(KEY_MEMORY, TX_PRIORITY_WAKE);
+  ASSERT_TRUE(sim.run_until([&] { return sim.desk.current_state() == DC_STATE_MEMORY; }, 2000));
+  sim.lose_key_frames = true;
+  sim.desk.press_keys(KEY_PRESET1, TX_PRIORITY_MOTION);
+  sim.run(500);
+  sim.lose_key_frames = false;
+
+  // the panel leaves the memory screen on its own, which is not a save
+  ASSERT_TRUE(sim.run_until([&] { return sim.desk.current_state() == DC_STATE_HEIGHT; }, 10000));
+  sim.run(2000);
+  EXPECT_TRUE(std::isnan(sim.desk.get_preset_height(1)));
+}
+
+}  // namespace
+}  // namespace loctekmotion_desk
+}  // namespace esphome
@@ -0,0 +1,73 @@
+#include "ring_buffer.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace {
+
+TEST(RingBuffer, PushPopInOrder) {
+  RingBuffer<8> buffer;
+  for (uint8_t i = 0; i < 8; i++)
+    EXPECT_TRUE(buffer.push(i));
+  EXPECT_FALSE(buffer.push(8));
+  EXPECT_EQ(buffer.size(), 8u);
+  uint8_t byte;
+  for (uint8_t i = 0; i < 8; i++) {
+    ASSERT_TRUE(buffer.pop(&byte));
+    EXPECT_EQ(byte, i);
+  }
+  EXPECT_FALSE(buffer.pop(&byte));
+  EXPECT_TRUE(buffer.empty());
+}
+
+TEST(RingBuffer, WrapsAroundIndexesAndCounters) {
+  RingBuffer<8> buffer;
+  uint8_t next_in = 0, next_out = 0, byte;
+  // enough rounds for the 8 bit counters to wrap several times
+  for (int round = 0; round < 1000; round++) {
+    int count = round % 7 + 1;
+    for (int i = 0; i < count; i++)
+      ASSERT_TRUE(buffer.push(next_in++));
+    ASSERT_EQ(buffer.size(), (size_t) count);
+    for (int i = 0; i < count; i++) {
+      ASSERT_TRUE(buffer.pop(&byte));
+      ASSERT_EQ(byte, next_out++);
+    }
+  }
+}
+
+TEST(RingBuffer, WriteRegionStopsAtTheEnd) {
+  RingBuffer<8> buffer;
+  uint8_t byte;
+  for (uint8_t i = 0; i < 6; i++)
+    buffer.push(i);
+  for (uint8_t i = 0; i < 4; i++)
+    buffer.pop(&byte);
+
+  size_t len;
+  uint8_t *region = buffer.write_region(&len);
+  EXPECT_EQ(len, 2u);  // up to the end of the storage
+  memset(region, 0xAA, len);
+  buffer.commit(len);
+
+  region = buffer.write_region(&len);
+  EXPECT_EQ(len, 4u);  // wrapped, up to the tail
+  memset(region, 0xBB, len);
+  buffer.commit(len);
+  EXPECT_EQ(buffer.free(), 0u);
+  buffer.write_region(&len);
+  EXPECT_EQ(len, 0u);
+
+  const uint8_t expected[] = {4, 5, 0xAA, 0xAA, 0xBB, 0xBB, 0xBB, 0xBB};
+  for (uint8_t value : expected) {
+    ASSERT_TRUE(buffer.pop(&byte));
+    EXPECT_EQ(byte, value);
+  }
+}
+
+}  // namespace
+}  // namespace loctekmotion_desk
+}  // namespace esphome
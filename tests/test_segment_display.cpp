@@ -0,0 +1,358 @@
+#include "frames.h"
+#include "segment_display.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace {
+
+using testing::build_frame;
+using testing::display_frame;
+using testing::height_frame;
+using testing::read_frames;
+
+using Bytes = std::vector<uint8_t>;
+
+Bytes concat(std::initializer_list<Bytes> parts) {
+  Bytes bytes;
+  for (const auto &part : parts)
+    bytes.insert(bytes.end(), part.begin(), part.end());
+  return bytes;
+}
+
+DataFrameReader new_reader() {
+  DataFrameReader reader{};
+  reader.reset();
+  return reader;
+}
+
+TEST(Crc16, TableMatchesBitwise) {
+  for (uint16_t crc : {0xFFFF, 0x0000, 0x1234, 0xA001}) {
+    for (int byte = 0; byte < 256; byte++)
+      EXPECT_EQ(crc16_update(crc, byte), crc16_update_bitwise(crc, byte)) << crc << " " << byte;
+  }
+}
+
+TEST(DataFrameReader, ReadsFrame) {
+  auto reader = new_reader();
+  Bytes frame = height_frame(75.3);
+  auto frames = read_frames(reader, frame);
+  ASSERT_EQ(frames.size(), 1u);
+  EXPECT_EQ(frames[0], frame);
+  EXPECT_TRUE(reader.complete);
+  EXPECT_TRUE(reader.crc_valid);
+  EXPECT_FALSE(reader.repeat);
+  EXPECT_EQ(reader.frame.type, DATA_TYPE_DISPLAY);
+  EXPECT_EQ(reader.errors().crc + reader.errors().framing + reader.errors().length, 0u);
+}
+
+TEST(DataFrameReader, DropsBytesBeforeStart) {
+  auto reader = new_reader();
+  auto frames = read_frames(reader, concat({{0x00, 0x12, 0x9d}, height_frame(80)}));
+  ASSERT_EQ(frames.size(), 1u);
+  EXPECT_EQ(reader.errors().dropped_bytes, 3u);
+}
+
+TEST(DataFrameReader, ResyncsOnLengthError) {
+  auto reader = new_reader();
+  // a start byte followed by an impossible length, the real frame starts right after
+  auto frames = read_frames(reader, concat({{DATA_FRAME_START, 0x7F}, height_frame(80)}));
+  ASSERT_EQ(frames.size(), 1u);
+  EXPECT_EQ(frames[0], height_frame(80));
+  EXPECT_EQ(reader.errors().length, 1u);
+}
+
+TEST(DataFrameReader, ResyncsOnFramingErrorToFrameInside) {
+  auto reader = new_reader();
+  // a frame cut off after 3 bytes, directly followed by a complete one
+  Bytes truncated = height_frame(90);
+  truncated.resize(3);
+  auto frames = read_frames(reader, concat({truncated, height_frame(91), height_frame(92)}));
+  ASSERT_EQ(frames.size(), 2u);
+  EXPECT_EQ(frames[0], height_frame(91));
+  EXPECT_EQ(frames[1], height_frame(92));
+  EXPECT_EQ(reader.errors().framing, 1u);
+}
+
+TEST(DataFrameReader, ResyncsOnCrcError) {
+  auto reader = new_reader();
+  Bytes corrupted = height_frame(100);
+  corrupted[4] ^= 0x01;
+  auto frames = read_frames(reader, concat({corrupted, height_frame(101)}));
+  ASSERT_EQ(frames.size(), 1u);
+  EXPECT_EQ(frames[0], height_frame(101));
+  EXPECT_EQ(reader.errors().crc, 1u);
+}
+
+TEST(DataFrameReader, MarksRepeatedDisplayFrames) {
+  auto reader = new_reader();
+  read_frames(reader, height_frame(75));
+  EXPECT_FALSE(reader.repeat);
+  ASSERT_EQ(read_frames(reader, height_frame(75)).size(), 1u);
+  EXPECT_TRUE(reader.repeat);
+  EXPECT_TRUE(reader.crc_valid);
+  ASSERT_EQ(read_frames(reader, height_frame(76)).size(), 1u);
+  EXPECT_FALSE(reader.repeat);
+}
+
+TEST(DataFrameReader, RepeatsOnlyDisplayFrames) {
+  auto reader = new_reader();
+  Bytes beep = build_frame(DATA_TYPE_BEEP, {0x7F});
+  read_frames(reader, beep);
+  ASSERT_EQ(read_frames(reader, beep).size(), 1u);
+  EXPECT_FALSE(reader.repeat);
+}
+
+TEST(DataFrameReader, CorruptedRepeatIsNotAccepted) {
+  auto reader = new_reader();
+  read_frames(reader, height_frame(75));
+  Bytes corrupted = height_frame(75);
+  corrupted[3] ^= 0x40;
+  EXPECT_TRUE(read_frames(reader, corrupted).empty());
+  EXPECT_EQ(reader.errors().crc, 1u);
+}
+
+TEST(DataFrameReader, RepeatWithAnotherCrcIsNotAccepted) {
+  // matches the last display frame up to its CRC, which is checked over the bytes that matched
+  auto reader = new_reader();
+  read_frames(reader, height_frame(75));
+  Bytes corrupted = height_frame(75);
+  corrupted[corrupted.size() - 2] ^= 0x01;
+  EXPECT_TRUE(read_frames(reader, corrupted).empty());
+  EXPECT_EQ(reader.errors().crc, 1u);
+  ASSERT_EQ(read_frames(reader, height_frame(75)).size(), 1u);
+  EXPECT_TRUE(reader.repeat);
+}
+
+/**
+ * The reader's behaviour spelled out over a whole stream: a frame is accepted where a start byte is
+ * followed by a valid frame, which is then skipped. Anything else is dropped one start byte at a time.
+ */
+struct ReferenceResult {
+  std::vector<Bytes> frames;
+  std::vector<bool> repeats;
+  DataFrameReaderErrors errors{};
+};
+
+ReferenceResult reference_read(const Bytes &stream) {
+  ReferenceResult result;
+  Bytes last_display;
+  size_t pos = 0;
+  while (pos < stream.size()) {
+    if (stream[pos] != DATA_FRAME_START) {
+      result.errors.dropped_bytes++;
+      pos++;
+      continue;
+    }
+    size_t left = stream.size() - pos;
+    if (left < 2)
+      break;
+    uint8_t length = stream[pos + 1];
+    if (length <= DATA_MIN_SIZE || length > DATA_MAX_SIZE) {
+      result.errors.length++;
+      result.errors.dropped_bytes++;
+      pos++;
+      continue;
+    }
+    size_t size = length + 2;
+    if (left < size)
+      break;
+    Bytes frame(stream.begin() + pos, stream.begin() + pos + size);
+    uint16_t crc = CRC16_INIT;
+    for (size_t i = 1; i < size - 3; i++)
+      crc = crc16_update_bitwise(crc, frame[i]);
+    if (frame[size - 1] != DATA_FRAME_END) {
+      result.errors.framing++;
+    } else if (crc != (frame[size - 3] << 8 | frame[size - 2])) {
+      result.errors.crc++;
+    } else {
+      result.repeats.push_back(frame == last_display);
+      if (frame[2] == DATA_TYPE_DISPLAY)
+        last_display = frame;
+      result.frames.push_back(frame);
+      pos += size;
+      continue;
+    }
+    result.errors.dropped_bytes++;
+    pos++;
+  }
+  return result;
+}
+
+TEST(DataFrameReader, MatchesReferenceOnRandomizedStream) {
+  std::mt19937 rng(42);
+  std::vector<Bytes> frames;
+  for (int i = 0; i < 6; i++)
+    frames.push_back(display_frame(rng() & 0xFF, rng() & 0xFF, rng() & 0xFF));
+  frames.push_back(height_frame(75.5));
+  frames.push_back(build_frame(DATA_TYPE_BEEP, {0x7F}));
+  frames.push_back(build_frame(DATA_TYPE_UNKNOWN_11, {0x01, 0x02}));
+  frames.push_back(build_frame(DATA_TYPE_UNKNOWN_15, {}));
+
+  Bytes stream;
+  for (int i = 0; i < 50000; i++) {
+    // mostly the same display frame, like the controller sends
+    Bytes frame = frames[rng() % 10 < 7 ? 0 : rng() % frames.size()];
+    if (rng() % 20 == 0)
+      frame[rng() % frame.size()] ^= 1 << (rng() % 8);
+    if (rng() % 50 == 0)
+      frame.resize(rng() % frame.size());
+    if (rng() % 100 == 0)
+      frame.insert(frame.begin() + rng() % frame.size(), DATA_FRAME_START);
+    stream.insert(stream.end(), frame.begin(), frame.end());
+  }
+  // so that the last frame start is either completed or dropped
+  stream.insert(stream.end(), DATA_FRAME_MAX_SIZE, 0x00);
+
+  ReferenceResult expected = reference_read(stream);
+  auto reader = new_reader();
+  std::vector<Bytes> actual;
+  std::vector<bool> repeats;
+  auto put = [&](uint8_t byte) {
+    if (reader.put(byte)) {
+      actual.emplace_back(reader.frame.raw, reader.frame.raw + reader.frame.size());
+      repeats.push_back(reader.repeat);
+    }
+  };
+  for (uint8_t byte : stream) {
+    put(byte);
+    uint8_t pending;
+    while (reader.pop_pending(&pending))
+      put(pending);
+  }
+
+  ASSERT_EQ(actual.size(), expected.frames.size());
+  EXPECT_GT(actual.size(), 40000u);
+  for (size_t i = 0; i < actual.size(); i++) {
+    ASSERT_EQ(actual[i], expected.frames[i]) << "frame " << i;
+    ASSERT_EQ(repeats[i], expected.repeats[i]) << "frame " << i;
+  }
+  EXPECT_EQ(reader.errors().crc, expected.errors.crc);
+  EXPECT_EQ(reader.errors().framing, expected.errors.framing);
+  EXPECT_EQ(reader.errors().length, expected.errors.length);
+  EXPECT_EQ(reader.errors().dropped_bytes, expected.errors.dropped_bytes);
+}
+
+struct DecodeCase {
+  uint8_t s1, s2, s3;
+  SegmentDisplayState state;
+  float height;
+  uint8_t minutes;
+};
+
+TEST(DecodeDisplay, DecodesEveryState) {
+  const DecodeCase cases[] = {
+      {SEGMENT_OFF, SEGMENT_OFF, SEGMENT_OFF, SD_STATE_OFF, 0, 0},
+      {SEGMENT_SYMBOL_S, SEGMENT_SYMBOL_DASH, SEGMENT_OFF, SD_STATE_MEMORY, 0, 0},
+      {SEGMENT_SYMBOL_COLON, SEGMENT_OFF, SEGMENT_OFF, SD_STATE_TIMER_DURATION_OFF, 0, 0},
+      {SEGMENT_OFF, SEGMENT_SYMBOL_O, SEGMENT_SYMBOL_N, SD_STATE_TIMER_ON, 0, 0},
+      {SEGMENT_SYMBOL_O, SEGMENT_SYMBOL_F, SEGMENT_SYMBOL_F, SD_STATE_TIMER_OFF, 0, 0},
+      {SEGMENT_SYMBOL_COLON, SEGMENT_SYMBOL_4, SEGMENT_SYMBOL_5, SD_STATE_TIMER_DURATION_ON, 0, 45},
+      {SEGMENT_OFF, SEGMENT_SYMBOL_0, SEGMENT_SYMBOL_9, SD_STATE_TIMER_DURATION_ONLY, 0, 9},
+      {SEGMENT_SYMBOL_7, SEGMENT_SYMBOL_5 | SEGMENT_DOT_BIT, SEGMENT_SYMBOL_3, SD_STATE_HEIGHT, 75.3f, 0},
+      {SEGMENT_SYMBOL_1, SEGMENT_SYMBOL_2, SEGMENT_SYMBOL_1, SD_STATE_HEIGHT, 121, 0},
+      {SEGMENT_SYMBOL_F, SEGMENT_SYMBOL_2, SEGMENT_SYMBOL_1, SD_STATE_UNKNOWN, 0, 0},
+      {SEGMENT_SYMBOL_1, SEGMENT_SYMBOL_DASH, SEGMENT_SYMBOL_1, SD_STATE_UNKNOWN, 0, 0},
+  };
+  for (const auto &c : cases) {
+    SegmentDisplay display{{c.s1, c.s2, c.s3}};
+    DecodedDisplay decoded = decode_display(&display);
+    SCOPED_TRACE(::testing::Message() << std::hex << (int) c.s1 << " " << (int) c.s2 << " " << (int) c.s3);
+    EXPECT_EQ(decoded.state, c.state);
+    EXPECT_FLOAT_EQ(decoded.height, c.height);
+    EXPECT_EQ(decoded.minutes, c.minutes);
+    EXPECT_EQ(get_display_state(&display), c.state);
+  }
+}
+
+// the getters as they were before decode_display(), each classifying the display again
+namespace baseline {
+
+uint8_t segment_to_digit(uint8_t s) {
+  switch (s & SEGMENT_SYMBOL_MASK) {
+    case SEGMENT_SYMBOL_0: return 0;
+    case SEGMENT_SYMBOL_1: return 1;
+    case SEGMENT_SYMBOL_2: return 2;
+    case SEGMENT_SYMBOL_3: return 3;
+    case SEGMENT_SYMBOL_4: return 4;
+    case SEGMENT_SYMBOL_5: return 5;
+    case SEGMENT_SYMBOL_6: return 6;
+    case SEGMENT_SYMBOL_7: return 7;
+    case SEGMENT_SYMBOL_8: return 8;
+    case SEGMENT_SYMBOL_9: return 9;
+    default: return 255;
+  }
+}
+
+SegmentDisplayState get_display_state(const SegmentDisplay *display) {
+  const uint8_t s1 = display->segment1, s2 = display->segment2, s3 = display->segment3;
+  if (s1 == SEGMENT_OFF && s2 == SEGMENT_OFF && s3 == SEGMENT_OFF)
+    return SD_STATE_OFF;
+  if (s1 == SEGMENT_SYMBOL_S && s2 == SEGMENT_SYMBOL_DASH && s3 == SEGMENT_OFF)
+    return SD_STATE_MEMORY;
+  if (s1 == SEGMENT_OFF && s2 == SEGMENT_SYMBOL_O && s3 == SEGMENT_SYMBOL_N)
+    return SD_STATE_TIMER_ON;
+  if (s1 == SEGMENT_SYMBOL_O && s2 == SEGMENT_SYMBOL_F && s3 == SEGMENT_SYMBOL_F)
+    return SD_STATE_TIMER_OFF;
+  if (s1 == SEGMENT_SYMBOL_COLON && s2 == SEGMENT_OFF && s3 == SEGMENT_OFF)
+    return SD_STATE_TIMER_DURATION_OFF;
+  if (s1 == SEGMENT_SYMBOL_COLON && segment_to_digit(s2) < 10 && segment_to_digit(s3) < 10)
+    return SD_STATE_TIMER_DURATION_ON;
+  if (s1 == SEGMENT_OFF && segment_to_digit(s2) < 10 && segment_to_digit(s3) < 10)
+    return SD_STATE_TIMER_DURATION_ONLY;
+  if (segment_to_digit(s1) < 10 && segment_to_digit(s2) < 10 && segment_to_digit(s3) < 10)
+    return SD_STATE_HEIGHT;
+  return SD_STATE_UNKNOWN;
+}
+
+float get_display_height(const SegmentDisplay *display) {
+  if (baseline::get_display_state(display) != SD_STATE_HEIGHT)
+    return 0;
+  float height = segment_to_digit(display->segment1) * 100 + segment_to_digit(display->segment2) * 10 +
+                 segment_to_digit(display->segment3);
+  return is_decimal(display->segment2) ? height / 10 : height;
+}
+
+uint8_t get_alarm_minutes(const SegmentDisplay *display) {
+  auto state = baseline::get_display_state(display);
+  if (state != SD_STATE_TIMER_DURATION_ON && state != SD_STATE_TIMER_DURATION_ONLY)
+    return 0;
+  return segment_to_digit(display->segment2) * 10 + segment_to_digit(display->segment3);
+}
+
+}  // namespace baseline
+
+TEST(DecodeDisplay, MatchesBaselineForEverySegmentCombination) {
+  uint32_t mismatches = 0;
+  for (uint32_t value = 0; value < (1u << 24); value++) {
+    SegmentDisplay display{{(uint8_t) (value >> 16), (uint8_t) (value >> 8), (uint8_t) value}};
+    DecodedDisplay decoded = decode_display(&display);
+    if (decoded.state != baseline::get_display_state(&display) ||
+        decoded.height != baseline::get_display_height(&display) ||
+        decoded.minutes != baseline::get_alarm_minutes(&display)) {
+      if (mismatches++ < 10)
+        ADD_FAILURE() << std::hex << "segments " << value << ": state " << (int) decoded.state << " height "
+                      << decoded.height << " minutes " << (int) decoded.minutes;
+    }
+  }
+  EXPECT_EQ(mismatches, 0u);
+}
+
+TEST(DecodeDisplay, DigitTableOnlyMapsDigits) {
+  int digits = 0;
+  for (int symbol = 0; symbol <= SEGMENT_SYMBOL_MASK; symbol++) {
+    if (segment_to_digit(symbol) != SEGMENT_NOT_DIGIT) {
+      EXPECT_EQ(testing::DIGITS[segment_to_digit(symbol)], symbol);
+      digits++;
+    }
+  }
+  EXPECT_EQ(digits, 10);
+  EXPECT_EQ(segment_to_digit(SEGMENT_SYMBOL_8 | SEGMENT_DOT_BIT), 8);
+}
+
+}  // namespace
+}  // namespace loctekmotion_desk
+}  // namespace esphome
@@ -0,0 +1,302 @@
+#include "state_machine.h"
+
+#include <gtest/gtest.h>
+
+#include <queue>
+#include <vector>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace {
+
+// feeds a height frame the way the component does: the height is set before the trigger
+bool height(DeskStateMachine &machine, float value) {
+  machine.set_height(value);
+  return machine.transition(SD_STATE_HEIGHT);
+}
+
+bool minutes(DeskStateMachine &machine, uint8_t value, SegmentDisplayState trigger = SD_STATE_TIMER_DURATION_ON) {
+  machine.set_timer_duration(value);
+  return machine.transition(trigger);
+}
+
+// the transitions as they were before the table, with the guards passed in
+DeskControlState baseline_transition(DeskControlState current_state_, DeskControlTrigger trigger, bool height_changed,
+                                     bool timer_done) {
+    auto has_height_changed = [&] { return height_changed; };
+    auto is_timer_done = [&] { return timer_done; };
+    DeskControlState new_state = DC_STATE_UNKNOWN;
+
+    switch (current_state_) {
+        case DC_STATE_UNKNOWN:
+            if (trigger == SD_STATE_OFF) {
+                new_state = DC_STATE_OFF;
+            } else if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_ONLY) {
+                new_state = DC_STATE_TIMER_ON;
+            }
+            break;
+        case DC_STATE_OFF:
+            if (trigger == SD_STATE_OFF) {
+                new_state = current_state_;
+            } else if (trigger == SD_STATE_MEMORY) {
+                new_state = DC_STATE_MEMORY;
+            } else if (trigger == SD_STATE_HEIGHT) {
+                new_state = DC_STATE_HEIGHT;
+            } else if (trigger == SD_STATE_TIMER_ON) {
+                new_state = DC_STATE_TIMER_STARTING;
+            }
+            break;
+
+        case DC_STATE_MEMORY:
+            if (trigger == SD_STATE_MEMORY) {
+                new_state = current_state_;
+            } else if (trigger == SD_STATE_HEIGHT) {
+                new_state = DC_STATE_HEIGHT;
+            }
+            break;
+
+        case DC_STATE_HEIGHT:
+            if (trigger == SD_STATE_OFF) {
+                new_state = DC_STATE_OFF;
+            } else if (trigger == SD_STATE_MEMORY) {
+                new_state = DC_STATE_MEMORY;
+            } else if (trigger == SD_STATE_HEIGHT) {
+                if (has_height_changed()) {
+                    new_state = DC_STATE_MOVING;
+                } else {
+                  new_state = current_state_;
+                }
+            } else if (trigger == SD_STATE_TIMER_ON) {
+                new_state = DC_STATE_TIMER_STARTING;
+            } else if (trigger == SD_STATE_TIMER_DURATION_ON) {
+                new_state = DC_STATE_TIMER_ON;
+            } else if (trigger == SD_STATE_TIMER_DURATION_ONLY) {
+                new_state = DC_STATE_TIMER_ON;
+            } else if (trigger == SD_STATE_MEMORY) {
+                new_state = DC_STATE_MEMORY;
+            }
+            break;
+
+        case DC_STATE_MOVING:
+            if (trigger == SD_STATE_HEIGHT) {
+              if (!has_height_changed()) {
+                new_state = DC_STATE_HEIGHT;
+              } else {
+                new_state = current_state_;
+              }
+            }
+            break;
+
+        case DC_STATE_TIMER_STARTING:
+            if (trigger == SD_STATE_TIMER_ON) {
+                new_state = current_state_;
+            } else if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_OFF) {
+                new_state = DC_STATE_TIMER_CHANGE;
+            }
+            break;
+
+        case DC_STATE_TIMER_CHANGE:
+            if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_OFF) {
+                new_state = current_state_;
+            } else if (trigger == SD_STATE_TIMER_DURATION_ONLY) {
+                new_state = DC_STATE_TIMER_ON;
+            } else if (trigger == SD_STATE_TIMER_OFF) {
+                new_state = DC_STATE_TIMER_OFF;
+            }
+            break;
+
+        case DC_STATE_TIMER_ON:
+            if ((trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_ONLY) && is_timer_done()) {
+                new_state = DC_STATE_TIMER_DONE;
+            } else if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_ONLY) {
+                new_state = current_state_;
+            } else if (trigger == SD_STATE_TIMER_DURATION_OFF) {
+                new_state = DC_STATE_TIMER_CHANGE;
+            } else if (trigger == SD_STATE_HEIGHT) {
+                new_state = DC_STATE_TIMER_MOVING;
+            } else if (trigger == SD_STATE_TIMER_OFF) {
+                new_state = DC_STATE_TIMER_OFF;
+            } else if (trigger == SD_STATE_MEMORY) {
+                new_state = DC_STATE_MEMORY;
+            }
+            break;
+
+        case DC_STATE_TIMER_MOVING:
+            if (trigger == SD_STATE_HEIGHT) {
+                new_state = current_state_;
+            } else if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_ONLY) {
+                new_state = DC_STATE_TIMER_ON;
+            }
+            break;
+
+        case DC_STATE_TIMER_DONE:
+            if (trigger == SD_STATE_TIMER_DURATION_ON || trigger == SD_STATE_TIMER_DURATION_ONLY) {
+                new_state = current_state_;
+            } else if (trigger == SD_STATE_HEIGHT) {
+                new_state = DC_STATE_HEIGHT;
+            } else if (trigger == SD_STATE_TIMER_DURATION_OFF) {
+                new_state = DC_STATE_TIMER_CHANGE;
+            } else if (trigger == SD_STATE_TIMER_OFF) {
+                new_state = DC_STATE_TIMER_OFF;
+            }
+            break;
+
+        case DC_STATE_TIMER_OFF:
+            if (trigger == SD_STATE_TIMER_OFF) {
+                new_state = current_state_;
+            } else if (trigger == SD_STATE_HEIGHT) {
+                new_state = DC_STATE_HEIGHT;
+            }
+            break;
+    }
+    return new_state;
+}
+
+struct Step {
+  DeskControlTrigger trigger;
+  bool height_changed;
+  bool timer_done;
+};
+
+// drives the machine so that its guards give the step's outcome
+bool apply(DeskStateMachine &machine, const Step &step) {
+  machine.set_timer_duration(step.timer_done ? 0 : 5);
+  if (step.trigger == SD_STATE_HEIGHT && step.height_changed)
+    machine.set_height(machine.height() + 1);
+  return machine.transition(step.trigger);
+}
+
+TEST(DeskStateMachine, MatchesBaselineSwitch) {
+  // every state reachable with the baseline, with the steps that reach it
+  std::vector<std::vector<Step>> paths(DC_STATE_COUNT);
+  std::vector<bool> reached(DC_STATE_COUNT, false);
+  std::queue<DeskControlState> queue;
+  reached[DC_STATE_UNKNOWN] = true;
+  queue.push(DC_STATE_UNKNOWN);
+
+  int checked = 0;
+  while (!queue.empty()) {
+    DeskControlState from = queue.front();
+    queue.pop();
+    for (uint8_t trigger = 0; trigger < SD_STATE_COUNT; trigger++) {
+      for (int guards = 0; guards < 4; guards++) {
+        Step step{static_cast<DeskControlTrigger>(trigger), (guards & 1) != 0, (guards & 2) != 0};
+        DeskControlState expected = baseline_transition(from, step.trigger, step.height_changed, step.timer_done);
+        if (expected == DC_STATE_UNKNOWN)
+          expected = from;
+
+        DeskStateMachine machine;
+        for (const auto &previous : paths[from])
+          apply(machine, previous);
+        ASSERT_EQ(machine.current_state(), from);
+        bool changed = apply(machine, step);
+        EXPECT_EQ(machine.current_state(), expected)
+            << "from " << (int) from << " on " << (int) trigger << " height changed " << step.height_changed
+            << " timer done " << step.timer_done;
+        EXPECT_EQ(changed, expected != from);
+        checked++;
+
+        if (!reached[expected]) {
+          reached[expected] = true;
+          paths[expected] = paths[from];
+          paths[expected].push_back(step);
+          queue.push(expected);
+        }
+      }
+    }
+  }
+  for (uint8_t state = 0; state < DC_STATE_COUNT; state++)
+    EXPECT_TRUE(reached[state]) << "state " << (int) state;
+  EXPECT_EQ(checked, DC_STATE_COUNT * SD_STATE_COUNT * 4);
+}
+
+TEST(DeskStateMachine, StartsUnknownAndWaitsForOff) {
+  DeskStateMachine machine;
+  EXPECT_EQ(machine.current_state(), DC_STATE_UNKNOWN);
+  EXPECT_FALSE(height(machine, 75));
+  EXPECT_EQ(machine.current_state(), DC_STATE_UNKNOWN);
+  EXPECT_TRUE(machine.transition(SD_STATE_OFF));
+  EXPECT_EQ(machine.current_state(), DC_STATE_OFF);
+}
+
+TEST(DeskStateMachine, MovesWhileHeightChanges) {
+  DeskStateMachine machine;
+  machine.transition(SD_STATE_OFF);
+  EXPECT_TRUE(height(machine, 75));
+  EXPECT_EQ(machine.current_state(), DC_STATE_HEIGHT);
+  EXPECT_FALSE(height(machine, 75));
+  EXPECT_EQ(machine.current_state(), DC_STATE_HEIGHT);
+  EXPECT_TRUE(height(machine, 75.5));
+  EXPECT_EQ(machine.current_state(), DC_STATE_MOVING);
+  EXPECT_FALSE(height(machine, 76));
+  EXPECT_EQ(machine.current_state(), DC_STATE_MOVING);
+  EXPECT_TRUE(height(machine, 76));
+  EXPECT_EQ(machine.current_state(), DC_STATE_HEIGHT);
+  EXPECT_TRUE(machine.transition(SD_STATE_OFF));
+  EXPECT_EQ(machine.current_state(), DC_STATE_OFF);
+}
+
+TEST(DeskStateMachine, MemoryMode) {
+  DeskStateMachine machine;
+  machine.transition(SD_STATE_OFF);
+  EXPECT_TRUE(machine.transition(SD_STATE_MEMORY));
+  EXPECT_EQ(machine.current_state(), DC_STATE_MEMORY);
+  EXPECT_TRUE(height(machine, 110));
+  EXPECT_EQ(machine.current_state(), DC_STATE_HEIGHT);
+}
+
+TEST(DeskStateMachine, SetsAndRunsTimer) {
+  DeskStateMachine machine;
+  machine.transition(SD_STATE_OFF);
+  EXPECT_TRUE(machine.transition(SD_STATE_TIMER_ON));
+  EXPECT_EQ(machine.current_state(), DC_STATE_TIMER_STARTING);
+  EXPECT_TRUE(minutes(machine, 45));
+  EXPECT_EQ(machine.current_state(), DC_STATE_TIMER_CHANGE);
+  EXPECT_FALSE(machine.transition(SD_STATE_TIMER_DURATION_OFF));  // blinking
+  EXPECT_TRUE(minutes(machine, 45, SD_STATE_TIMER_DURATION_ONLY));
+  EXPECT_EQ(machine.current_state(), DC_STATE_TIMER_ON);
+  EXPECT_FALSE(minutes(machine, 44));
+  EXPECT_EQ(machine.current_state(), DC_STATE_TIMER_ON);
+  EXPECT_TRUE(height(machine, 75));
+  EXPECT_EQ(machine.current_state(), DC_STATE_TIMER_MOVING);
+  EXPECT_TRUE(minutes(machine, 44));
+  EXPECT_EQ(machine.current_state(), DC_STATE_TIMER_ON);
+  EXPECT_TRUE(minutes(machine, 0));
+  EXPECT_EQ(machine.current_state(), DC_STATE_TIMER_DONE);
+  EXPECT_TRUE(height(machine, 75));
+  EXPECT_EQ(machine.current_state(), DC_STATE_HEIGHT);
+}
+
+TEST(DeskStateMachine, TurnsTimerOff) {
+  DeskStateMachine machine;
+  machine.transition(SD_STATE_OFF);
+  machine.transition(SD_STATE_TIMER_ON);
+  minutes(machine, 30);
+  EXPECT_TRUE(machine.transition(SD_STATE_TIMER_OFF));
+  EXPECT_EQ(machine.current_state(), DC_STATE_TIMER_OFF);
+  EXPECT_FALSE(machine.transition(SD_STATE_TIMER_OFF));
+  EXPECT_TRUE(height(machine, 75));
+  EXPECT_EQ(machine.current_state(), DC_STATE_HEIGHT);
+}
+
+TEST(DeskStateMachine, ResumesRunningTimerAfterBoot) {
+  DeskStateMachine machine;
+  EXPECT_TRUE(minutes(machine, 12));
+  EXPECT_EQ(machine.current_state(), DC_STATE_TIMER_ON);
+}
+
+TEST(DeskStateMachine, IgnoresUnexpectedTriggers) {
+  DeskStateMachine machine;
+  machine.transition(SD_STATE_OFF);
+  height(machine, 75);
+  height(machine, 76);
+  ASSERT_EQ(machine.current_state(), DC_STATE_MOVING);
+  EXPECT_FALSE(machine.transition(SD_STATE_TIMER_OFF));
+  EXPECT_FALSE(machine.transition(SD_STATE_UNKNOWN));
+  EXPECT_FALSE(machine.transition(static_cast<DeskControlTrigger>(200)));
+  EXPECT_EQ(machine.current_state(), DC_STATE_MOVING);
+}
+
+}  // namespace
+}  // namespace loctekmotion_desk
+}  // namespace esphome
@@ -0,0 +1,82 @@
+// The timer sensor against the controller model counting down, with the panel showing the minutes for
+// one second out of every four
+
+#include "desk_model.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace {
+
+using testing::DeskModelConfig;
+using testing::DeskSimulation;
+using testing::MODEL_HEIGHT;
+
+const uint32_t TIMER_MINUTES = 5;
+
+DeskModelConfig minute_ms(uint32_t timer_minute_ms) {
+  DeskModelConfig config;
+  config.timer_minute_ms = timer_minute_ms;
+  return config;
+}
+
+class TimerCountdown : public ::testing::Test {
+ protected:
+  explicit TimerCountdown(uint32_t timer_minute_ms = 60000) : sim(minute_ms(timer_minute_ms)) {}
+
+  void SetUp() override {
+    // the countdown started with the simulated clock, the panel shows the minutes rounded up
+    sim.model.mode = MODEL_HEIGHT;
+    sim.model.timer_minutes = TIMER_MINUTES;
+    sim.model.timer_running = true;
+    sim.desk.set_timer_sensor(&timer);
+    sim.setup();
+  }
+
+  // whole seconds left, rounded up like the panel rounds the minutes
+  static int32_t remaining_seconds() {
+    int32_t remaining_ms = (int32_t) (TIMER_MINUTES * 60000 - millis());
+    return remaining_ms > 0 ? (remaining_ms + 999) / 1000 : 0;
+  }
+
+  DeskSimulation sim;
+  sensor::Sensor timer;
+};
+
+TEST_F(TimerCountdown, FollowsTheCountdown) {
+  // the first minute change anchors the countdown exactly
+  sim.run(61000);
+  int32_t worst = 0;
+  while (remaining_seconds() > 0) {
+    sim.run(250);
+    int32_t error = std::abs((int32_t) timer.state - remaining_seconds());
+    worst = std::max(worst, error);
+  }
+  EXPECT_LE(worst, 1);
+  sim.run(2000);
+  EXPECT_EQ(timer.state, 0);
+}
+
+// a panel whose minutes are a second short, so its minute changes fall while it shows the timer, and the
+// countdown drifts out of the range the minutes allow. Both anchor it again.
+class FastPanelCountdown : public TimerCountdown {
+ protected:
+  FastPanelCountdown() : TimerCountdown(59000) {}
+};
+
+TEST_F(FastPanelCountdown, AnchoringDoesNotRescheduleTheTicks) {
+  sim.run(1000);
+  uint32_t scheduled = stub::scheduled_count();
+  uint32_t publishes = timer.publishes;
+  sim.run(4 * 59000);
+  EXPECT_EQ(stub::scheduled_count(), scheduled);
+  // one publish per second, not one per anchor on top
+  EXPECT_LE(timer.publishes - publishes, 4 * 60 + 1);
+}
+
+}  // namespace
+}  // namespace loctekmotion_desk
+}  // namespace esphome
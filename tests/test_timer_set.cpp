@@ -0,0 +1,94 @@
+// timer_set against the controller model: holding up/down while far from the target, one press per
+// minute near it, and the fallback when the controller doesn't repeat held keys
+
+#include "desk_model.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace {
+
+using testing::DeskModelConfig;
+using testing::DeskSimulation;
+using testing::MODEL_HEIGHT;
+
+/**
+ * Sets the timer from a running one. Returns the time it took until the new countdown started, or 0 if it
+ * didn't reach the target within a minute.
+ */
+uint32_t set_timer(uint8_t from, uint8_t to, bool fast_set, bool key_repeat = true) {
+  DeskModelConfig config;
+  config.key_repeat = key_repeat;
+  DeskSimulation sim(config);
+  sim.model.mode = MODEL_HEIGHT;
+  sim.model.timer_minutes = from;
+  sim.model.timer_running = true;
+  sim.desk.set_timer_fast_set(fast_set);
+  sim.setup();
+  sim.run(3000);
+
+  uint32_t start = millis();
+  sim.desk.set_timer_duration(to);
+  bool set = sim.run_until(
+      [&] { return sim.model.timer_running && sim.model.mode == MODEL_HEIGHT && sim.model.timer_minutes == to; }, 60000);
+  return set ? millis() - start : 0;
+}
+
+TEST(TimerSet, SetsTimerUpAndDown) {
+  for (auto [from, to] : {std::pair<uint8_t, uint8_t>{45, 44}, {45, 47}, {45, 10}, {10, 60}, {5, 99}, {60, 1}}) {
+    EXPECT_GT(set_timer(from, to, true), 0u) << (int) from << " -> " << (int) to;
+    EXPECT_GT(set_timer(from, to, false), 0u) << (int) from << " -> " << (int) to << " stepping";
+  }
+}
+
+TEST(TimerSet, HoldingIsFasterThanStepping) {
+  // every 7th duration to every 7th duration
+  uint64_t fast_total = 0, stepping_total = 0;
+  uint32_t fast_worst = 0, stepping_worst = 0, count = 0;
+  for (uint8_t from = 1; from <= 99; from += 7) {
+    for (uint8_t to = 1; to <= 99; to += 7) {
+      if (from == to)
+        continue;
+      uint32_t fast = set_timer(from, to, true);
+      uint32_t stepping = set_timer(from, to, false);
+      ASSERT_GT(fast, 0u) << (int) from << " -> " << (int) to;
+      ASSERT_GT(stepping, 0u) << (int) from << " -> " << (int) to << " stepping";
+      fast_total += fast;
+      stepping_total += stepping;
+      fast_worst = std::max(fast_worst, fast);
+      stepping_worst = std::max(stepping_worst, stepping);
+      count++;
+    }
+  }
+  printf("%u settings, holding %.1f s average (%.1f s worst), stepping %.1f s average (%.1f s worst)\n", count,
+         fast_total / 1000.0 / count, fast_worst / 1000.0, stepping_total / 1000.0 / count, stepping_worst / 1000.0);
+  EXPECT_LT(fast_total, stepping_total);
+  EXPECT_LT(fast_worst, stepping_worst);
+}
+
+TEST(TimerSet, FallsBackToSteppingWithoutKeyRepeat) {
+  EXPECT_GT(set_timer(45, 10, true, false), 0u);
+  EXPECT_GT(set_timer(10, 30, true, false), 0u);
+}
+
+TEST(TimerSet, SetsTimerRequestedWhileTheDisplayGoesOff) {
+  // no timer running, so the controller goes from showing the height straight to sleep
+  DeskSimulation sim;
+  sim.setup();
+  ASSERT_TRUE(sim.run_until([&] { return sim.desk.current_state() == DC_STATE_OFF; }, 2000));
+  sim.desk.press_keys(KEY_MEMORY, TX_PRIORITY_MOTION);
+  ASSERT_TRUE(sim.run_until([&] { return sim.desk.current_state() == DC_STATE_HEIGHT; }, 2000));
+
+  sim.desk.set_timer_duration(30);
+  EXPECT_TRUE(sim.run_until(
+      [&] { return sim.model.timer_running && sim.model.mode == MODEL_HEIGHT && sim.model.timer_minutes == 30; },
+      60000));
+}
+
+}  // namespace
+}  // namespace loctekmotion_desk
+}  // namespace esphome
@@ -0,0 +1,101 @@
+#include "tx_queue.h"
+
+#include <gtest/gtest.h>
+
+namespace esphome {
+namespace loctekmotion_desk {
+namespace {
+
+const uint8_t A[] = {0xA};
+const uint8_t B[] = {0xB};
+const uint8_t C[] = {0xC};
+const uint8_t D[] = {0xD};
+
+uint8_t pop(TxQueue<4> &queue) {
+  TxFrame frame;
+  EXPECT_TRUE(queue.pop(&frame));
+  return frame.data[0];
+}
+
+TEST(TxQueue, SendsByPriorityThenInOrder) {
+  TxQueue<4> queue;
+  queue.push(A, 1, TX_PRIORITY_TIMER, 1);
+  queue.push(B, 1, TX_PRIORITY_MOTION, 2);
+  queue.push(C, 1, TX_PRIORITY_TIMER, 3);
+  queue.push(D, 1, TX_PRIORITY_STOP, 4);
+  EXPECT_EQ(pop(queue), 0xD);
+  EXPECT_EQ(pop(queue), 0xB);
+  EXPECT_EQ(pop(queue), 0xA);
+  EXPECT_EQ(pop(queue), 0xC);
+  TxFrame frame;
+  EXPECT_FALSE(queue.pop(&frame));
+}
+
+TEST(TxQueue, KeepsOrderAfterRemovingFromTheMiddle) {
+  TxQueue<4> queue;
+  queue.push(A, 1, TX_PRIORITY_MOTION, 1);
+  queue.push(B, 1, TX_PRIORITY_TIMER, 2);
+  queue.push(C, 1, TX_PRIORITY_MOTION, 3);
+  queue.push(D, 1, TX_PRIORITY_MOTION, 4);
+  EXPECT_EQ(queue.remove_priority(TX_PRIORITY_TIMER), 1u);
+  EXPECT_EQ(pop(queue), 0xA);
+  EXPECT_EQ(pop(queue), 0xC);
+  EXPECT_EQ(pop(queue), 0xD);
+}
+
+TEST(TxQueue, KeepsOrderOfFramesQueuedInTheSameMillisecond) {
+  TxQueue<4> queue;
+  queue.push(A, 1, TX_PRIORITY_MOTION, 5);
+  queue.push(B, 1, TX_PRIORITY_MOTION, 5);
+  queue.push(C, 1, TX_PRIORITY_STOP, 5);
+  queue.push(D, 1, TX_PRIORITY_MOTION, 5);
+  // sent from the middle, the last frame fills the gap
+  EXPECT_EQ(pop(queue), 0xC);
+  EXPECT_EQ(pop(queue), 0xA);
+  EXPECT_EQ(pop(queue), 0xB);
+  EXPECT_EQ(pop(queue), 0xD);
+}
+
+TEST(TxQueue, CoalescesSameFrame) {
+  TxQueue<4> queue;
+  EXPECT_EQ(queue.push(A, 1, TX_PRIORITY_TIMER, 1), TX_QUEUED);
+  EXPECT_EQ(queue.push(B, 1, TX_PRIORITY_MOTION, 2), TX_QUEUED);
+  EXPECT_EQ(queue.push(A, 1, TX_PRIORITY_STOP, 3), TX_COALESCED);
+  EXPECT_EQ(queue.size(), 2u);
+  EXPECT_EQ(pop(queue), 0xA);  // raised to the higher priority
+}
+
+TEST(TxQueue, ReplacesNewestLowestPriorityWhenFull) {
+  TxQueue<4> queue;
+  queue.push(A, 1, TX_PRIORITY_WAKE, 1);
+  queue.push(B, 1, TX_PRIORITY_WAKE, 2);
+  queue.push(C, 1, TX_PRIORITY_MOTION, 3);
+  queue.push(D, 1, TX_PRIORITY_MOTION, 4);
+  const uint8_t E[] = {0xE};
+  EXPECT_EQ(queue.push(E, 1, TX_PRIORITY_WAKE, 5), TX_REJECTED);
+  EXPECT_EQ(queue.push(E, 1, TX_PRIORITY_STOP, 5), TX_REPLACED);
+  EXPECT_EQ(pop(queue), 0xE);
+  EXPECT_EQ(pop(queue), 0xC);
+  EXPECT_EQ(pop(queue), 0xD);
+  EXPECT_EQ(pop(queue), 0xA);  // B was dropped
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(TxQueue, RejectsOversizedFrames) {
+  TxQueue<4> queue;
+  uint8_t long_frame[TX_FRAME_MAX_SIZE + 1] = {};
+  EXPECT_EQ(queue.push(long_frame, sizeof(long_frame), TX_PRIORITY_STOP, 0), TX_REJECTED);
+  EXPECT_EQ(queue.push(long_frame, 0, TX_PRIORITY_STOP, 0), TX_REJECTED);
+}
+
+TEST(TxQueue, DropsStaleFramesAcrossMillisWrap) {
+  TxQueue<4> queue;
+  queue.push(A, 1, TX_PRIORITY_MOTION, 0xFFFFFF00);
+  queue.push(B, 1, TX_PRIORITY_MOTION, 0x00000010);
+  EXPECT_EQ(queue.remove_older_than(0x00000020, 100), 1u);
+  EXPECT_EQ(pop(queue), 0xB);
+}
+
+}  // namespace
+}  // namespace loctekmotion_desk
+}  // namespace esphome
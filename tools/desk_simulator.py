@@ -0,0 +1,508 @@
+#!/usr/bin/env python3
+"""Simulates the desk controller, to run the component without a desk.
+
+The simulator creates a pty (or opens a serial port with --port) and plays the
+controller: it sends a display frame every frame slot (108 ms by default) and
+reacts to the key frames it receives, like the real one:
+
+  - up/down move the desk while held, with acceleration and deceleration
+  - presets 1-3 move to their stored height, M followed by a preset stores it
+  - A shows ON, then the duration blinking while up/down change it (held keys
+    repeat), A or 5 s without keys starts the countdown. Going below 1 turns the
+    timer OFF. When the countdown elapses the display shows :00 and beeps
+  - the display goes off after --sleep seconds without keys, M only wakes it
+
+  desk_simulator.py                        # prints the pty to point the UART at
+  desk_simulator.py --link /tmp/desk       # also symlinks it to a fixed path
+  desk_simulator.py --port /dev/ttyUSB0    # through a USB serial adapter
+  desk_simulator.py --timer-minute 1 --duration 120 --report run.jsonl
+
+Simulated time advances by exactly one frame slot per frame, and key frames act
+on the slot after they were received, so the same key frames in the same slots
+give the same display frames. Which slot a key frame lands in is not fixed: it
+depends on when it arrives over the pty or serial port, so runs against a
+component can differ by a slot here and there. Each command (key frames after a
+quiet period) is reported with its latency (first key frame until the display
+shows its effect) and its time to completion (until the desk and the timer
+settings are idle again), both in simulated milliseconds, in whole slots.
+
+tests/desk_host.cpp runs the host build of the component against it, see
+tests/e2e_desk_simulator.py.
+"""
+
+import argparse
+import json
+import os
+import select
+import sys
+import time
+
+from loctek_protocol import (
+    FRAME_END,
+    FRAME_START,
+    KEY_DOWN,
+    KEY_FRAME_SIZE,
+    KEY_MEMORY,
+    KEY_PRESET1,
+    KEY_PRESET2,
+    KEY_PRESET3,
+    KEY_TIMER,
+    KEY_UP,
+    SEGMENT_COLON,
+    SEGMENT_DASH,
+    SEGMENT_DIGITS,
+    SEGMENT_DOT,
+    SEGMENT_F,
+    SEGMENT_N,
+    SEGMENT_O,
+    SEGMENT_OFF,
+    SEGMENT_S,
+    TYPE_BEEP,
+    TYPE_DISPLAY,
+    TYPE_KEYS,
+    build_frame,
+    crc16,
+    key_names,
+    make_raw,
+    open_serial,
+)
+
+KEY_HOLD_MS = 150  # a key is released when no frame repeats it for this long
+MAX_SPEED = 3.8  # cm/s
+ACCELERATION = 20.0  # cm/s²
+DECELERATION = 12.0  # cm/s²
+TIMER_ON_SCREEN_MS = 400  # "ON" shown before the duration can be changed
+TIMER_EDIT_TIMEOUT_MS = 5000  # no keys for this long while changing the duration starts the countdown
+TIMER_BLINK_MS = 500
+TIMER_REPEAT_DELAY_MS = 500  # held up/down repeat after this long
+TIMER_REPEAT_INTERVAL_MS = 100
+TIMER_DEFAULT_MINUTES = 45
+TIMER_SHOW_EVERY_MS = 4000  # the running countdown is shown for one second out of four
+TIMER_OFF_SCREEN_MS = 1000
+TIMER_DONE_SCREEN_MS = 5000
+MEMORY_SCREEN_MS = 5000
+BEEP_INTERVAL_MS = 1000
+QUIET_MS = 1000  # no key frames and nothing changing for this long ends a command
+
+# modes of the display
+OFF = "off"
+HEIGHT = "height"
+MEMORY = "memory"
+TIMER_ON = "timer_on"
+TIMER_EDIT = "timer_edit"
+TIMER_OFF = "timer_off"
+TIMER_DONE = "timer_done"
+
+
+class DeskModel:
+    """The controller, advanced one frame slot at a time."""
+
+    def __init__(self, height, min_height, max_height, presets, sleep_ms, timer_minute_ms):
+        self.height = height
+        self.min_height = min_height
+        self.max_height = max_height
+        self.presets = list(presets)
+        self.sleep_ms = sleep_ms
+        self.timer_minute_ms = timer_minute_ms
+        self.speed = 0.0
+        self.target = None  # preset height being moved to
+        self.mode = OFF
+        self.mode_time = 0
+        self.keys = 0
+        self.key_time = -KEY_HOLD_MS
+        self.key_press_time = 0  # start of the current hold
+        self.repeat_time = 0
+        self.last_key_time = 0
+        self.timer_minutes = 0  # duration being edited, or remaining while running
+        self.timer_running = False
+        self.timer_minute_start = 0
+        self.beep_time = None
+
+    # --- keys
+
+    def key_frame(self, keys, now):
+        held = self.keys if now - self.key_time < KEY_HOLD_MS else 0
+        new_press = keys != held
+        self.keys = keys
+        self.key_time = now
+        if keys:
+            self.last_key_time = now
+        if new_press:
+            self.key_press_time = now
+            self.repeat_time = now
+            if keys:
+                self.press(keys, now)
+        elif keys and self.mode == TIMER_EDIT and keys in (KEY_UP, KEY_DOWN):
+            if now - self.key_press_time >= TIMER_REPEAT_DELAY_MS and now - self.repeat_time >= TIMER_REPEAT_INTERVAL_MS:
+                self.repeat_time = now
+                self.change_timer(1 if keys == KEY_UP else -1, now)
+
+    def press(self, keys, now):
+        if self.mode == OFF:
+            self.set_mode(HEIGHT, now)
+            if keys == KEY_MEMORY:
+                return  # only wakes the display
+        preset = {KEY_PRESET1: 0, KEY_PRESET2: 1, KEY_PRESET3: 2}.get(keys)
+
+        if keys == KEY_TIMER:
+            if self.mode == TIMER_EDIT:
+                self.start_timer(now)
+            elif self.mode != TIMER_ON:
+                self.target = None
+                if not self.timer_minutes:
+                    self.timer_minutes = TIMER_DEFAULT_MINUTES
+                self.timer_running = False
+                self.set_mode(TIMER_ON, now)
+        elif self.mode == TIMER_EDIT and keys in (KEY_UP, KEY_DOWN):
+            self.change_timer(1 if keys == KEY_UP else -1, now)
+        elif keys == KEY_MEMORY:
+            self.target = None
+            self.set_mode(MEMORY, now)
+        elif preset is not None and self.mode == MEMORY:
+            self.presets[preset] = self.shown_height()
+            self.set_mode(HEIGHT, now)
+        elif preset is not None:
+            self.target = min(self.max_height, max(self.min_height, self.presets[preset]))
+            self.set_mode(HEIGHT, now)
+        elif keys & (KEY_UP | KEY_DOWN):
+            self.target = None  # any key stops moving to a preset
+            if self.mode in (TIMER_DONE, MEMORY, TIMER_OFF):
+                self.set_mode(HEIGHT, now)
+
+    def change_timer(self, step, now):
+        self.timer_minutes = max(0, min(99, self.timer_minutes + step))
+        self.mode_time = now  # restarts the edit timeout
+
+    def start_timer(self, now):
+        if self.timer_minutes == 0:
+            self.timer_running = False
+            self.set_mode(TIMER_OFF, now)
+            return
+        self.timer_running = True
+        self.timer_minute_start = now
+        self.set_mode(HEIGHT, now)
+
+    def set_mode(self, mode, now):
+        self.mode = mode
+        self.mode_time = now
+
+    # --- time
+
+    def step(self, now, dt):
+        in_mode = now - self.mode_time
+        if self.mode == TIMER_ON and in_mode >= TIMER_ON_SCREEN_MS:
+            self.set_mode(TIMER_EDIT, now)
+        elif self.mode == TIMER_EDIT and in_mode >= TIMER_EDIT_TIMEOUT_MS:
+            self.start_timer(now)
+        elif self.mode == MEMORY and in_mode >= MEMORY_SCREEN_MS:
+            self.set_mode(HEIGHT, now)
+        elif self.mode == TIMER_OFF and in_mode >= TIMER_OFF_SCREEN_MS:
+            self.set_mode(HEIGHT, now)
+        elif self.mode == TIMER_DONE and in_mode >= TIMER_DONE_SCREEN_MS:
+            self.beep_time = None
+            self.set_mode(HEIGHT, now)
+
+        if self.timer_running and now - self.timer_minute_start >= self.timer_minute_ms:
+            self.timer_minute_start += self.timer_minute_ms
+            self.timer_minutes -= 1
+            if self.timer_minutes == 0:
+                self.timer_running = False
+                self.target = None
+                self.set_mode(TIMER_DONE, now)
+                self.beep_time = now
+
+        self.move(now, dt)
+
+        if (self.mode == HEIGHT and not self.timer_running and not self.moving(now)
+                and now - self.last_key_time >= self.sleep_ms):
+            self.set_mode(OFF, now)
+
+    def move(self, now, dt):
+        held = self.keys if now - self.key_time < KEY_HOLD_MS else 0
+        motion_keys = self.mode in (HEIGHT, OFF)
+        direction = 0
+        if motion_keys and held == KEY_UP:
+            direction = 1
+        elif motion_keys and held == KEY_DOWN:
+            direction = -1
+        elif self.target is not None:
+            # brake in time to stop at the preset
+            remaining = self.target - self.height
+            braking = self.speed * self.speed / (2 * DECELERATION)
+            if abs(remaining) > braking + 0.05:
+                direction = 1 if remaining > 0 else -1
+        target_speed = direction * MAX_SPEED
+        rate = (ACCELERATION if direction else DECELERATION) * dt / 1000
+        if self.speed < target_speed:
+            self.speed = min(target_speed, self.speed + rate)
+        elif self.speed > target_speed:
+            self.speed = max(target_speed, self.speed - rate)
+        self.height += self.speed * dt / 1000
+        if self.height <= self.min_height or self.height >= self.max_height:
+            self.height = min(self.max_height, max(self.min_height, self.height))
+            self.speed = 0
+        if self.target is not None and self.speed == 0 and direction == 0:
+            if abs(self.target - self.height) < 0.3:
+                self.height = self.target
+            self.target = None
+
+    def moving(self, now):
+        return self.speed != 0 or self.target is not None
+
+    # --- display
+
+    def shown_height(self):
+        tenths = round(self.height * 10)
+        return tenths // 10 if tenths >= 1000 else tenths / 10
+
+    def view(self, now):
+        """What the display shows, without blinking: (mode, value)"""
+        if self.mode == HEIGHT and self.timer_running and (now - self.timer_minute_start) % TIMER_SHOW_EVERY_MS < 1000:
+            return "timer", self.timer_minutes
+        if self.mode in (TIMER_EDIT, TIMER_DONE):
+            return self.mode, self.timer_minutes
+        if self.mode == HEIGHT:
+            return HEIGHT, self.shown_height()
+        return self.mode, None
+
+    def state(self):
+        """What a command can change, to tell when it had an effect and when it's done"""
+        edited = self.timer_minutes if self.mode in (TIMER_EDIT, TIMER_DONE) else None
+        return self.mode, self.shown_height(), self.timer_running, edited
+
+    def segments(self, now):
+        mode, value = self.view(now)
+        blink_off = (now - self.mode_time) // TIMER_BLINK_MS % 2 == 1
+        if mode == OFF:
+            return SEGMENT_OFF, SEGMENT_OFF, SEGMENT_OFF
+        if mode == MEMORY:
+            return SEGMENT_S, SEGMENT_DASH, SEGMENT_OFF
+        if mode == TIMER_ON:
+            return SEGMENT_OFF, SEGMENT_O, SEGMENT_N
+        if mode == TIMER_OFF:
+            return SEGMENT_O, SEGMENT_F, SEGMENT_F
+        if mode in (TIMER_EDIT, TIMER_DONE):
+            if blink_off and mode == TIMER_EDIT:
+                return SEGMENT_COLON, SEGMENT_OFF, SEGMENT_OFF
+            return SEGMENT_COLON, SEGMENT_DIGITS[value // 10], SEGMENT_DIGITS[value % 10]
+        if mode == "timer":
+            return SEGMENT_OFF, SEGMENT_DIGITS[value // 10], SEGMENT_DIGITS[value % 10]
+        tenths = round(self.height * 10)
+        if tenths >= 1000:
+            whole = tenths // 10
+            return SEGMENT_DIGITS[whole // 100], SEGMENT_DIGITS[whole // 10 % 10], SEGMENT_DIGITS[whole % 10]
+        return (SEGMENT_DIGITS[tenths // 100], SEGMENT_DIGITS[tenths // 10 % 10] | SEGMENT_DOT,
+                SEGMENT_DIGITS[tenths % 10])
+
+    def frames(self, now):
+        """Frames to send in this slot"""
+        frames = [build_frame(TYPE_DISPLAY, bytes(self.segments(now)) + b"\x00\x00")]
+        if self.beep_time is not None and now >= self.beep_time:
+            self.beep_time += BEEP_INTERVAL_MS
+            frames.append(build_frame(TYPE_BEEP))
+        return frames
+
+    def idle(self, now):
+        return not self.moving(now) and self.mode not in (TIMER_ON, TIMER_EDIT, MEMORY)
+
+
+class KeyFrameReader:
+    def __init__(self):
+        self.buffer = bytearray()
+        self.bad_frames = 0
+
+    def feed(self, data):
+        """Returns the keys of the complete key frames in data."""
+        self.buffer += data
+        keys = []
+        while True:
+            start = self.buffer.find(FRAME_START)
+            if start < 0:
+                self.buffer.clear()
+                return keys
+            del self.buffer[:start]
+            if len(self.buffer) < KEY_FRAME_SIZE:
+                return keys
+            frame = bytes(self.buffer[:KEY_FRAME_SIZE])
+            crc = crc16(frame[1:5])
+            if (frame[1] == KEY_FRAME_SIZE - 2 and frame[2] == TYPE_KEYS and frame[7] == FRAME_END
+                    and frame[5:7] == bytes([crc >> 8, crc & 0xFF])):
+                keys.append(frame[3])
+                del self.buffer[:KEY_FRAME_SIZE]
+            else:
+                self.bad_frames += 1
+                del self.buffer[:1]
+
+
+class CommandTracker:
+    """Splits the key frames into commands and measures them."""
+
+    def __init__(self, report):
+        self.report = report
+        self.command = None
+        self.commands = []
+
+    def key_frame(self, keys, now, desk):
+        if self.command is None:
+            if not keys:
+                return
+            self.command = {
+                "start_ms": now,
+                "keys": 0,
+                "key_frames": 0,
+                "state": desk.state(),
+                "latency_ms": None,
+                "last_change_ms": now,
+            }
+        self.command["keys"] |= keys
+        self.command["key_frames"] += 1
+        self.command["last_key_ms"] = now
+
+    def slot(self, now, desk):
+        command = self.command
+        if command is None:
+            return
+        state = desk.state()
+        if state != command["state"]:
+            command["state"] = state
+            command["last_change_ms"] = now
+            if command["latency_ms"] is None:
+                command["latency_ms"] = now - command["start_ms"]
+        quiet_since = max(command["last_change_ms"], command["last_key_ms"])
+        if desk.idle(now) and now - quiet_since >= QUIET_MS:
+            self.finish(desk, now)
+
+    def finish(self, desk, now):
+        command = self.command
+        self.command = None
+        result = {
+            "start_s": command["start_ms"] / 1000,
+            "keys": key_names(command["keys"]),
+            "key_frames": command["key_frames"],
+            "latency_ms": command["latency_ms"],
+            "completion_ms": command["last_change_ms"] - command["start_ms"],
+            "height": desk.shown_height(),
+            "timer_minutes": desk.timer_minutes if desk.timer_running else 0,
+        }
+        self.commands.append(result)
+        latency = "-" if result["latency_ms"] is None else f"{result['latency_ms']} ms"
+        print(f"{result['start_s']:9.3f} {result['keys']:<16} {result['key_frames']:>4} frames  latency {latency:>8}  "
+              f"completed in {result['completion_ms'] / 1000:6.2f} s  height {result['height']}  "
+              f"timer {result['timer_minutes']}", flush=True)
+        if self.report:
+            self.report.write(json.dumps(result) + "\n")
+            self.report.flush()
+
+    def summary(self):
+        if not self.commands:
+            print("no commands received")
+            return
+        by_keys = {}
+        for command in self.commands:
+            by_keys.setdefault(command["keys"], []).append(command)
+        print(f"{'keys':<16} {'count':>5} {'latency min/avg/max (ms)':>26} {'completion avg (s)':>19}")
+        for keys, commands in sorted(by_keys.items()):
+            latencies = [c["latency_ms"] for c in commands if c["latency_ms"] is not None]
+            completion = sum(c["completion_ms"] for c in commands) / len(commands) / 1000
+            if latencies:
+                latency = f"{min(latencies)}/{sum(latencies) // len(latencies)}/{max(latencies)}"
+            else:
+                latency = "-"
+            print(f"{keys:<16} {len(commands):>5} {latency:>26} {completion:>19.2f}")
+
+
+def open_link(args):
+    """Returns the fd to talk through, and the fds to keep open."""
+    if args.port:
+        fd = open_serial(args.port)
+        return fd, [fd]
+    master, slave = os.openpty()
+    make_raw(slave)
+    name = os.ttyname(slave)
+    if args.link:
+        if os.path.islink(args.link):
+            os.unlink(args.link)
+        os.symlink(name, args.link)
+        name = f"{name} ({args.link})"
+    print(f"controller on {name}", file=sys.stderr, flush=True)
+    # the slave stays open, so the master does not see a hangup while the component reconnects
+    return master, [master, slave]
+
+
+def run(args, fd, desk, tracker):
+    reader = KeyFrameReader()
+    interval = args.frame_interval
+    end = args.duration * 1000 if args.duration else None
+    start = time.monotonic()
+    now = 0
+    pending = []  # keys received during the current slot
+    while end is None or now < end:
+        for keys in pending:
+            tracker.key_frame(keys, now - interval, desk)  # received during the previous slot
+            desk.key_frame(keys, now)
+        pending = []
+
+        desk.step(now, interval)
+        for frame in desk.frames(now):
+            os.write(fd, frame)
+        tracker.slot(now, desk)
+
+        # receive until the next slot is due in real time
+        now += interval
+        while True:
+            timeout = start + now / 1000 / args.speed - time.monotonic()
+            if timeout <= 0:
+                break
+            readable, _, _ = select.select([fd], [], [], timeout)
+            if not readable:
+                break
+            try:
+                data = os.read(fd, 256)
+            except OSError:
+                data = b""  # no reader on the other side yet
+            pending += reader.feed(data)
+    if reader.bad_frames:
+        print(f"{reader.bad_frames} bad key frames", file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", help="serial port to use instead of a pty")
+    parser.add_argument("--link", metavar="PATH", help="symlink the pty to this path")
+    parser.add_argument("--frame-interval", type=int, default=108, metavar="MS", help="frame slot (default: 108)")
+    parser.add_argument("--speed", type=float, default=1.0, help="run faster than real time (default: 1)")
+    parser.add_argument("--duration", type=float, metavar="S", help="stop after this many simulated seconds")
+    parser.add_argument("--height", type=float, default=75.0, help="initial height in cm (default: 75)")
+    parser.add_argument("--min-height", type=float, default=72.0, help="default: 72")
+    parser.add_argument("--max-height", type=float, default=121.0, help="default: 121")
+    parser.add_argument("--presets", type=float, nargs=3, default=[75.0, 110.0, 90.0], metavar="CM",
+                        help="preset heights (default: 75 110 90)")
+    parser.add_argument("--sleep", type=float, default=10.0, metavar="S",
+                        help="display goes off after this many seconds without keys (default: 10)")
+    parser.add_argument("--timer-minute", type=float, default=60.0, metavar="S",
+                        help="length of a timer minute, shorten to test the timer quickly (default: 60)")
+    parser.add_argument("--report", metavar="FILE", help="append each command as a JSON line")
+    args = parser.parse_args()
+
+    desk = DeskModel(args.height, args.min_height, args.max_height, args.presets,
+                     int(args.sleep * 1000), int(args.timer_minute * 1000))
+    report = open(args.report, "a") if args.report else None
+    tracker = CommandTracker(report)
+    fd, fds = open_link(args)
+    try:
+        run(args, fd, desk, tracker)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        for open_fd in fds:
+            os.close(open_fd)
+        if args.link and not args.port and os.path.islink(args.link):
+            os.unlink(args.link)
+        if report:
+            report.close()
+    tracker.summary()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
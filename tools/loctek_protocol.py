@@ -0,0 +1,84 @@
+"""Frame format of the LoctekMotion desk controller link, shared by the tools.
+
+  frame: 9B <length> <type> <data...> <crc hi> <crc lo> 9D
+
+length counts the bytes from the length byte up to the CRC. The CRC is Modbus-CRC16
+over the same bytes, without the CRC itself (see segment_display.h).
+"""
+
+import os
+import termios
+
+FRAME_START = 0x9B
+FRAME_END = 0x9D
+
+TYPE_KEYS = 0x02
+TYPE_DISPLAY = 0x12
+TYPE_BEEP = 0x14
+
+KEY_FRAME_SIZE = 8
+
+# key bits of a key frame, as in key_frame.h
+KEY_UP = 0x01
+KEY_DOWN = 0x02
+KEY_PRESET1 = 0x04
+KEY_PRESET2 = 0x08
+KEY_PRESET3 = 0x10
+KEY_MEMORY = 0x20
+KEY_TIMER = 0x40
+KEY_NAMES = {
+    KEY_UP: "UP",
+    KEY_DOWN: "DOWN",
+    KEY_PRESET1: "PRESET1",
+    KEY_PRESET2: "PRESET2",
+    KEY_PRESET3: "PRESET3",
+    KEY_MEMORY: "M",
+    KEY_TIMER: "A",
+}
+
+# 7-segment symbols, as in segment_display.h
+SEGMENT_OFF = 0x00
+SEGMENT_DOT = 0x80
+SEGMENT_DIGITS = [0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F]
+SEGMENT_DASH = 0x40
+SEGMENT_F = 0x71
+SEGMENT_S = 0x6D
+SEGMENT_O = 0x3F
+SEGMENT_N = 0x37
+SEGMENT_COLON = 0x09
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def build_frame(frame_type, data=b""):
+    body = bytes([len(data) + 4, frame_type]) + bytes(data)
+    crc = crc16(body)
+    return bytes([FRAME_START]) + body + bytes([crc >> 8, crc & 0xFF, FRAME_END])
+
+
+def key_names(keys):
+    return "|".join(name for bit, name in KEY_NAMES.items() if keys & bit) or "NONE"
+
+
+def open_serial(port):
+    """Opens a serial port (or pty) raw at 9600 8N1."""
+    fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+    make_raw(fd)
+    return fd
+
+
+def make_raw(fd):
+    attrs = termios.tcgetattr(fd)
+    attrs[0] = 0  # iflag
+    attrs[1] = 0  # oflag
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL  # cflag: 8N1
+    attrs[3] = 0  # lflag
+    attrs[4] = attrs[5] = termios.B9600
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
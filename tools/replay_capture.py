@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Extracts a flight recorder capture from device logs and replays it.
+
+Dump the capture on the device with the `loctekmotion_desk.flight_recorder_dump`
+action and save the logs (e.g. `esphome logs desk.yaml > desk.log`). Then:
+
+  replay_capture.py desk.log --list                # print the frames
+  replay_capture.py desk.log --save capture.bin    # keep the binary capture
+  replay_capture.py capture.bin --port /dev/ttyUSB0 --speed 4
+
+Replaying writes the frames to a serial port (9600 8N1) with their original
+timing divided by --speed. Connect the adapter's TX to the RX of a device
+running the component (instead of the desk controller) to feed the capture
+through its frame reader and state machine. Without a device, the host build's
+loctekmotion_desk_replay does the same with a saved capture (tests/desk_replay.cpp).
+"""
+
+import argparse
+import os
+import re
+import sys
+import time
+
+from loctek_protocol import FRAME_END, FRAME_START, open_serial
+
+MAGIC = b"LMFR"
+VERSION = 1
+
+LOG_LINE = re.compile(r"FR:([0-9A-F]+)")
+
+
+def extract_from_log(text):
+    """Returns bytes of the last capture found in the log text."""
+    captures = []
+    current = None
+    for line in text.splitlines():
+        if "FR BEGIN" in line:
+            current = bytearray()
+        elif "FR END" in line:
+            if current is not None:
+                captures.append(bytes(current))
+            current = None
+        elif current is not None:
+            match = LOG_LINE.search(line)
+            if match:
+                current += bytes.fromhex(match.group(1))
+    if not captures:
+        raise ValueError("no complete capture (FR BEGIN ... FR END) found in log")
+    return captures[-1]
+
+
+def load_capture(path):
+    with open(path, "rb") as file:
+        data = file.read()
+    if data.startswith(MAGIC):
+        return data
+    return extract_from_log(data.decode("utf-8", errors="replace"))
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def decode_capture(data):
+    """Yields (time_ms, frame) where frame includes start and end bytes."""
+    if data[: len(MAGIC)] != MAGIC:
+        raise ValueError("not a flight recorder capture")
+    if data[len(MAGIC)] != VERSION:
+        raise ValueError(f"unsupported capture version {data[len(MAGIC)]}")
+
+    pos = len(MAGIC) + 1
+    time_ms = 0
+    last_frame = None
+    while pos < len(data):
+        value, pos = read_varint(data, pos)
+        time_ms += value >> 1
+        if value & 1:
+            frame = last_frame  # repeat of the previous frame
+        else:
+            length = data[pos]
+            frame = bytes([FRAME_START]) + data[pos : pos + length] + bytes([FRAME_END])
+            pos += length
+        last_frame = frame
+        if frame is not None:  # oldest repeats may refer to a frame that was already dropped
+            yield time_ms, frame
+
+
+def replay(frames, fd, speed):
+    start = time.monotonic()
+    for time_ms, frame in frames:
+        delay = start + time_ms / 1000 / speed - time.monotonic()
+        if delay > 0:
+            time.sleep(delay)
+        os.write(fd, frame)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", help="log file with a dumped capture, or a binary capture")
+    parser.add_argument("--list", action="store_true", help="print frames with their timestamps")
+    parser.add_argument("--save", metavar="FILE", help="save the binary capture")
+    parser.add_argument("--port", help="serial port to replay the frames to")
+    parser.add_argument("--speed", type=float, default=1.0, help="replay speed multiplier (default: 1)")
+    args = parser.parse_args()
+
+    data = load_capture(args.capture)
+
+    if args.save:
+        with open(args.save, "wb") as file:
+            file.write(data)
+
+    if args.list:
+        for time_ms, frame in decode_capture(data):
+            print(f"{time_ms / 1000:10.3f} {frame.hex(':').upper()}")
+
+    if args.port:
+        fd = open_serial(args.port)
+        try:
+            replay(decode_capture(data), fd, args.speed)
+        finally:
+            os.close(fd)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""Compiles the component with different feature sets and reports RAM/flash usage.
+
+Features that are not configured are compiled out (see the `USE_LOCTEKMOTION_DESK_*`
+defines in the component's `__init__.py`). This builds a minimal node with the height
+sensor and the up/down/timer buttons, then adds one feature at a time, and prints the
+size of each build and the difference to the minimal one:
+
+  size_report.py                      # ESP8266 (d1_mini)
+  size_report.py --platform esp32 --board esp32dev
+
+Needs `esphome` on the PATH. Builds go to a temporary directory that is removed
+afterwards, pass --keep to look at them.
+
+Without esphome, --host reads the same rows from the host build (see CMakeLists.txt),
+which links a node with one desk for each feature, dropping unused code like the
+firmware link: the code and static data, and the size of the desk object. These are
+x86-64 sizes, with the stubbed ESPHome core and the C++ runtime in the totals. Use
+them to compare features with each other, not as ESP32/ESP8266 byte counts:
+
+  cmake -S . -B build && cmake --build build
+  size_report.py --host build
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+COMPONENTS_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "components")
+
+SIZE_LINE = re.compile(r"^(RAM|Flash):.*\(used (\d+) bytes from (\d+) bytes\)", re.MULTILINE)
+
+BASE = """
+esphome:
+  name: desk-size
+{platform}:
+  board: {board}
+external_components:
+  - source:
+      type: local
+      path: {components}
+    components: [ loctekmotion_desk ]
+logger:
+  baud_rate: 0
+uart:
+  baud_rate: 9600
+  tx_pin: {tx_pin}
+  rx_pin: {rx_pin}
+loctekmotion_desk:
+  id: desk
+  height:
+    name: "Height"
+  up_button:
+    name: "Up"
+  down_button:
+    name: "Down"
+  timer_button:
+    name: "Timer"
+{desk}
+{extra}
+"""
+
+TIMER_SET = """
+button:
+  - platform: template
+    name: "Timer 30m"
+    on_press:
+      - loctekmotion_desk.timer_set: 30
+"""
+
+MOVE_TO_HEIGHT = """
+button:
+  - platform: template
+    name: "Standing"
+    on_press:
+      - loctekmotion_desk.move_to_height: 110
+"""
+
+# name, extra options under loctekmotion_desk, extra top level config
+FEATURES = [
+    ("minimal", "", ""),
+    ("control_status", "  control_status:\n    name: \"Control Status\"", ""),
+    ("timer sensor", "  timer:\n    name: \"Timer\"", ""),
+    ("timer_set action", "", TIMER_SET),
+    ("motion sensors", "  velocity:\n    name: \"Velocity\"\n  eta:\n    name: \"ETA\"", ""),
+    ("move_to_height action", "", MOVE_TO_HEIGHT),
+    ("preset heights", "  preset1_height:\n    name: \"Preset 1\"", ""),
+    ("usage statistics", "  sitting_time:\n    name: \"Sitting Time\"", ""),
+    ("diagnostics", "  frame_rate:\n    name: \"Frame Rate\"", ""),
+    ("transition trace", "  transition_trace_size: 32", ""),
+    ("flight recorder", "  flight_recorder_size: 1024", ""),
+    ("count_allocations", "  count_allocations: true", ""),
+]
+
+PINS = {
+    "esp8266": ("TX", "RX"),
+    "esp32": ("GPIO17", "GPIO16"),
+}
+
+
+def build(workdir, name, platform, board, desk, extra):
+    tx_pin, rx_pin = PINS[platform]
+    path = os.path.join(workdir, slug(name) + ".yaml")
+    with open(path, "w") as file:
+        file.write(BASE.format(platform=platform, board=board, components=os.path.abspath(COMPONENTS_DIR),
+                               tx_pin=tx_pin, rx_pin=rx_pin, desk=desk, extra=extra))
+    result = subprocess.run(["esphome", "compile", path], capture_output=True, text=True)
+    output = result.stdout + result.stderr
+    if result.returncode != 0:
+        sys.stderr.write(output)
+        raise RuntimeError(f"build '{name}' failed")
+    sizes = {kind: int(used) for kind, used, _ in SIZE_LINE.findall(output)}
+    if "RAM" not in sizes or "Flash" not in sizes:
+        raise RuntimeError(f"no size summary in the output of build '{name}'")
+    return sizes
+
+
+def slug(name):
+    return re.sub(r"\W+", "_", name)
+
+
+def host_build(build_dir, name):
+    """Sizes of the size probe of a feature in the host build, a node with one desk"""
+    probe = os.path.join(build_dir, f"loctekmotion_desk_size_{slug(name)}")
+    if not os.path.exists(probe):
+        raise RuntimeError(f"{probe} not found, build the host build first")
+    output = subprocess.run(["size", probe], capture_output=True, text=True, check=True).stdout
+    text, data, bss = (int(field) for field in output.splitlines()[1].split()[:3])
+    desk = int(subprocess.run([probe], capture_output=True, text=True, check=True).stdout)
+    return {"Code": text, "Static": data + bss, "Desk": desk}
+
+
+def print_table(rows, columns):
+    base = rows[0][1]
+    print(f"| {'Build':<22} |" + "".join(f" {column:>8} | {'+' + column:>8} |" for column in columns))
+    print(f"| {'-' * 22} |" + f" {'-' * 8} | {'-' * 8} |" * len(columns))
+    for name, sizes in rows:
+        print(f"| {name:<22} |" + "".join(f" {sizes[column]:>8} | {sizes[column] - base[column]:>+8} |"
+                                           for column in columns))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--platform", choices=sorted(PINS), default="esp8266")
+    parser.add_argument("--board", default="d1_mini")
+    parser.add_argument("--keep", action="store_true", help="keep the build directory")
+    parser.add_argument("--host", metavar="BUILD_DIR", help="read the sizes from the host build instead")
+    args = parser.parse_args()
+
+    if args.host:
+        rows = [(name, host_build(args.host, name)) for name, _, _ in FEATURES + [("all features", "", "")]]
+        print_table(rows, ["Code", "Static", "Desk"])
+        return
+
+    workdir = tempfile.mkdtemp(prefix="desk-size-")
+    try:
+        rows = []
+        all_desk = []
+        all_extra = []
+        for name, desk, extra in FEATURES:
+            print(f"building {name}...", file=sys.stderr)
+            rows.append((name, build(workdir, name, args.platform, args.board, desk, extra)))
+            all_desk.append(desk)
+            all_extra.append(extra)
+
+        # the action configs each declare a button list, merge them into one
+        extra = "button:\n" + "".join(e.split("button:\n", 1)[1] for e in all_extra if e)
+        print("building all features...", file=sys.stderr)
+        rows.append(("all features", build(workdir, "all", args.platform, args.board,
+                                           "\n".join(d for d in all_desk if d), extra)))
+    finally:
+        if args.keep:
+            print(f"builds kept in {workdir}", file=sys.stderr)
+        else:
+            shutil.rmtree(workdir, ignore_errors=True)
+
+    print_table(rows, ["RAM", "Flash"])
+
+
+if __name__ == "__main__":
+    main()